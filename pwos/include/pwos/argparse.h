@@ -120,6 +120,27 @@ public:
      */
     float getFloat(string id, float defaultValue);
 
+    /**
+     * Return the comma separated values (e.g. --threads 1,2,4) of the string flag with id "id".
+     * Throws an error if arg corresponding to id is not a string or has no values.
+     * 
+     * @param id
+     * @param defaultValue  comma separated default values
+     * 
+     * @returns the values corresponding to id or the default values
+     */
+    vector<string> getStrList(string id, string defaultValue);
+
+    /**
+     * Like getStrList, the values are converted to ints.
+     */
+    vector<int> getIntList(string id, string defaultValue);
+
+    /**
+     * Like getStrList, the values are converted to floats.
+     */
+    vector<float> getFloatList(string id, string defaultValue);
+
     /**
      * Returns the string corresponding to the ith non-flagged argument
      * 
@@ -129,6 +150,11 @@ public:
      */
     string getMain(int i, string errMsg = "");
 
+    /**
+     * @returns the number of main arguments
+     */
+    int getNumMain();
+
 private:
     // main args (i.e. no flags, in order they appear)
     vector<string> main;
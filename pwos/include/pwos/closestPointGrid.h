@@ -62,7 +62,13 @@ public:
      * @param cellLength    the cell length (square cells)
      * @param nthreads      the number of threads used to compute grid
      */
-    ClosestPointGrid(shared_ptr<Scene> scene, Vec2f bl, Vec2f tr, float cellLength, int nthreads = 1);
+    ClosestPointGrid(shared_ptr<const Scene> scene, Vec2f bl, Vec2f tr, float cellLength, int nthreads = 1);
+
+    ~ClosestPointGrid();
+
+    ClosestPointGrid(const ClosestPointGrid&) = delete;
+
+    ClosestPointGrid& operator=(const ClosestPointGrid&) = delete;
 
     /**
      * Indicate whether or not p is in the grid's range.
@@ -85,7 +91,7 @@ public:
      */
     inline int getBlockId(Vec2f p) const
     {
-        THROW_IF(!pointInGridRange(p), "(1) Invalid point, not in range of the grid: " + to_string(p.x()) + ", " + to_string(p.y()));
+        ASSERT_IF(!pointInGridRange(p), "(1) Invalid point, not in range of the grid: " + to_string(p.x()) + ", " + to_string(p.y()));
         Vec2i g = getGridCoordinates(p);
         return getBlockId(g, p);
     }
@@ -98,12 +104,12 @@ public:
      * @return the id of the block that contains the grid point
      * 
      */
-    inline int getBlockId(Vec2i g, Vec2f p) const
+    inline int getBlockId(Vec2i g, [[maybe_unused]] Vec2f p) const
     {
-        int bidx = floor(g.x() / blockWidth);
-        int bidy = floor(g.y() / blockHeight);
+        int bidx = g.x() / blockWidth;
+        int bidy = g.y() / blockHeight;
         int bid = bidx + bidy * nBlockCols;
-        THROW_IF(bid < 0 || bid >= nBlocks, "(2) Invalid grid point, not in range of the grid: " + to_string(g.x()) + ", " + to_string(g.y()) + " (Block id: " + to_string(bid) + ") " + to_string(p.x()) + ", " + to_string(p.y()));
+        ASSERT_IF(bid < 0 || bid >= nBlocks, "(2) Invalid grid point, not in range of the grid: " + to_string(g.x()) + ", " + to_string(g.y()) + " (Block id: " + to_string(bid) + ") " + to_string(p.x()) + ", " + to_string(p.y()));
         return bid;
     }
 
@@ -118,10 +124,10 @@ public:
      */
     inline int getBlockId(Vec2i g, Vec2i &b) const
     {
-        b.x() = floor(float(g.x()) / blockWidth);
-        b.y() = floor(float(g.y()) / blockHeight);
+        b.x() = g.x() / blockWidth;
+        b.y() = g.y() / blockHeight;
         int bid = b.x() + b.y() * nBlockCols;
-        THROW_IF(bid < 0 || bid >= nBlocks, "(3) Invalid grid point, not in range of the grid: " + to_string(g.x()) + ", " + to_string(g.y()) + " (Block id: " + to_string(bid) + ")");
+        ASSERT_IF(bid < 0 || bid >= nBlocks, "(3) Invalid grid point, not in range of the grid: " + to_string(g.x()) + ", " + to_string(g.y()) + " (Block id: " + to_string(bid) + ")");
         return bid;
     }
 
@@ -138,7 +144,7 @@ public:
            floor((p.x() - bl.x()) / cellLength),
            floor((p.y() - bl.y()) / cellLength)
         );
-        THROW_IF(g.x() < 0 || g.x() >= gridWidth || g.y() < 0 || g.y() >= gridHeight, "Point p is not in grid range!");
+        ASSERT_IF(g.x() < 0 || g.x() >= gridWidth || g.y() < 0 || g.y() >= gridHeight, "Point p is not in grid range!");
         return g;
     }
 
@@ -175,6 +181,46 @@ public:
         );
     }
 
+    /**
+     * Returns the morton code of the grid cell containing p. Sorting points by this code
+     * makes consecutive lookups touch nearby cells. Points outside the grid are clamped to its border.
+     *
+     * @param p     a point in 2D
+     *
+     * @return the morton code of the (clamped) grid cell
+     */
+    inline uint32_t getMortonCode(Vec2f p) const
+    {
+        int gx = std::clamp(int(floor((p.x() - bl.x()) / cellLength)), 0, std::min(gridWidth - 1, 0xffff));
+        int gy = std::clamp(int(floor((p.y() - bl.y()) / cellLength)), 0, std::min(gridHeight - 1, 0xffff));
+        return mortonEncode(gx, gy);
+    }
+
+    /**
+     * Issue a software prefetch for the grid data that a lookup at p will read.
+     *
+     * @param p     a point in 2D
+     */
+    inline void prefetch(Vec2f p) const
+    {
+        if (!pointInGridRange(p)) return;
+        __builtin_prefetch(&grid[getGridPointIndex(getGridCoordinates(p))]);
+    }
+
+    /**
+     * Returns a conservative distance from p to the boundary (distance stored at the grid point minus
+     * the distance from p to that grid point). Unlike getDistToClosestPoint, the boundary value is not fetched.
+     *
+     * @param p     a point in the grid's range
+     *
+     * @return a lower bound on the distance from p to the boundary
+     */
+    inline float getConservativeDist(Vec2f p) const
+    {
+        Vec2i g = getGridCoordinates(p);
+        return grid[getGridPointIndex(g)].dist - (p - getGridPointCoordinates(g)).norm();
+    }
+
     /**
      * Returns the distance to the closest point and pointer to shape that distance corresponds to.
      * This allows callers of the function to access the relevant boundary data (assumed constant per shape)
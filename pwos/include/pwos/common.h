@@ -20,6 +20,10 @@
 #include <numeric>
 #include <algorithm>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 using std::mutex;
 using std::string;
 using std::unique_ptr;
@@ -46,12 +50,11 @@ typedef std::chrono::duration<float> fsec;
 
 typedef Eigen::Vector<float, Eigen::Dynamic> Vectorf;
 typedef Eigen::Vector<int, 2> Vec2i;
+typedef Eigen::Vector<int, 4> Vec4i;
 typedef Eigen::Vector<float, 2> Vec2f;
 typedef Eigen::Vector<float, 3> Vec3f;
 typedef Eigen::Vector<float, 4> Vec4f;
 
-typedef std::function<Vec3f(Vec2f, pcg32&)> Rand2DFunction;
-typedef std::function<void()> FunctionBlock;
 
 inline void THROW(string message)
 {
@@ -68,6 +71,30 @@ inline void WARN_IF(bool cond, string message)
     if (cond) std::cerr << message << std::endl;
 }
 
+// Checks on hot paths (e.g. grid indexing), enabled by default in debug builds (NDEBUG not defined).
+// Can be forced on or off with -DPWOS_ASSERTS=1/0.
+#ifndef PWOS_ASSERTS
+#ifdef NDEBUG
+#define PWOS_ASSERTS 0
+#else
+#define PWOS_ASSERTS 1
+#endif
+#endif
+
+// Like THROW_IF, but the message expression is only evaluated if the check fails, and
+// the whole check is compiled out when PWOS_ASSERTS is 0.
+#if PWOS_ASSERTS
+#define ASSERT_IF(cond, message) do { if (cond) THROW(message); } while (0)
+#else
+#define ASSERT_IF(cond, message) do {} while (0)
+#endif
+
+// Per-thread timers, counters and tracing, can be compiled out with -DPWOS_STATS=0 (the run level
+// timers used by Stats::TIME and the counts set with Stats::SET_COUNT are always kept).
+#ifndef PWOS_STATS
+#define PWOS_STATS 1
+#endif
+
 // epsilon used for general purpose calculations
 #define EPSILON 1e-6
 
@@ -101,9 +128,13 @@ enum IntegratorType
     MCWOG_VISUAL,
     WOG,
     WOG_VISUAL,
+    WOG_PACKET,
+    WOG_COROUTINE,
+    WAVEFRONT,
     GRID_VISUAL,
     DISTANCE,
-    WOS
+    WOS,
+    WOS_PACKET
 };
 
 const map<string, IntegratorType> StrToIntegratorType({
@@ -111,9 +142,13 @@ const map<string, IntegratorType> StrToIntegratorType({
     { "mcwogviz", IntegratorType::MCWOG_VISUAL },
     { "wog", IntegratorType::WOG },
     { "wogviz", IntegratorType::WOG_VISUAL },
+    { "wogpacket", IntegratorType::WOG_PACKET },
+    { "wogcoro", IntegratorType::WOG_COROUTINE },
+    { "wavefront", IntegratorType::WAVEFRONT },
     { "gridviz", IntegratorType::GRID_VISUAL },
     { "dist", IntegratorType::DISTANCE },
-    { "wos", IntegratorType::WOS }
+    { "wos", IntegratorType::WOS },
+    { "wospacket", IntegratorType::WOS_PACKET }
 });
 
 enum class StatTimerType
@@ -125,33 +160,143 @@ enum class StatTimerType
     CLOSEST_POINT_GRID,
     CLOSEST_POINT_QUERY,
     SETUP_CLOSEST_POINT_QUERY,
-    SETUP
+    SETUP,
+    RENDER
 };
 
+inline const char* getStatTimerName(StatTimerType type)
+{
+    switch (type)
+    {
+        case StatTimerType::TOTAL: return "total";
+        case StatTimerType::GRID_CREATION: return "grid creation";
+        case StatTimerType::SEND_WALKS: return "send walks";
+        case StatTimerType::RECV_WALKS: return "recv walks";
+        case StatTimerType::CLOSEST_POINT_GRID: return "grid query";
+        case StatTimerType::CLOSEST_POINT_QUERY: return "closest point query";
+        case StatTimerType::SETUP_CLOSEST_POINT_QUERY: return "setup closest point query";
+        case StatTimerType::SETUP: return "setup";
+        case StatTimerType::RENDER: return "render";
+    }
+    return "unknown";
+}
+
 enum class StatType
 {
     GRID_POINTS,
     CLOSEST_POINT_QUERY,
     SETUP_CLOSEST_POINT_QUERY,
-    GRID_QUERY
+    GRID_QUERY,
+    WALKS,
+    WALK_STEPS,
+    GRID_FALLBACK
+};
+
+/**
+ * How a random walk ended.
+ */
+enum class WalkTermination
+{
+    BOUNDARY_HIT,
+    RUSSIAN_ROULETTE
 };
 
+// number of WalkTerminations
+constexpr int NUM_WALK_TERMINATIONS = int(WalkTermination::RUSSIAN_ROULETTE) + 1;
+
+inline const char* getWalkTerminationName(WalkTermination termination)
+{
+    switch (termination)
+    {
+        case WalkTermination::BOUNDARY_HIT: return "boundary hit";
+        case WalkTermination::RUSSIAN_ROULETTE: return "russian roulette";
+    }
+    return "unknown";
+}
+
 //========================//
 // Helper functions       //
 //========================//
-inline pcg32 getSampler(int id = 0)
+
+// seed of all samplers (see getSampler), set with --seed
+inline uint64_t samplerSeed = 0;
+
+/**
+ * Scramble the bits of x (splitmix64 finalizer), nearby inputs give unrelated outputs.
+ */
+inline uint64_t mixBits(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Returns the sampler of one sample (walk) of a pixel. It only depends on the seed, the pixel and the
+ * sample, so a sample sees the same random numbers no matter which thread takes it or when, and
+ * renders are reproducible across runs and thread counts.
+ *
+ * @param pixel     index of the pixel
+ * @param sample    index of the sample within the pixel
+ */
+inline pcg32 getSampler(uint64_t pixel, uint64_t sample)
 {
-  std::random_device rd;
-  std::mt19937_64 gen(rd());
-  std::uniform_int_distribution<uint64_t> dis;
-  uint64_t seed = dis(gen);
-  return pcg32(seed + id);
+    return pcg32(mixBits(samplerSeed ^ mixBits(pixel ^ mixBits(sample))), pixel);
+}
+
+/**
+ * The samplers of a range of samples of one pixel, handed to the functions that estimate a pixel.
+ */
+struct PixelSampler
+{
+    int pixel;
+
+    // index of the first sample of the range
+    int firstSample;
+
+    /**
+     * @return the sampler of the j-th sample of the range
+     */
+    inline pcg32 get(int j) const
+    {
+        return getSampler(pixel, firstSample + j);
+    }
+};
+
+/**
+ * Branch free sine and cosine (cephes single precision polynomials), written so that
+ * loops calling it over the lanes of a packet vectorize. Scalar and packet walks both
+ * step with it (see sampleCirclePoint), so that they take exactly the same steps.
+ *
+ * @param theta     angle in radians (must be non-negative)
+ * @param s         sin(theta)
+ * @param c         cos(theta)
+ */
+inline void fastSinCos(float theta, float &s, float &c)
+{
+    // reduce to [-pi/4, pi/4] and remember the quadrant
+    int j = int(theta * float(4.0 / M_PI));
+    j = (j + 1) & ~1;
+    float y = float(j);
+    float x = ((theta - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+    float z = x * x;
+
+    float pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    float ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+
+    int q = (j >> 1) & 3;
+    float sq = (q & 1) ? pc : ps;
+    float cq = (q & 1) ? ps : pc;
+    s = (q >= 2) ? -sq : sq;
+    c = (q == 1 || q == 2) ? -cq : cq;
 }
 
 inline Vec2f sampleCirclePoint(float R, float rand)
 {
-    float theta = rand * 2 * M_PI;
-    return Vec2f(cos(theta), sin(theta)) * R;
+    float s, c;
+    fastSinCos(rand * float(2.0 * M_PI), s, c);
+    return Vec2f(R * c, R * s);
 }
 
 inline Vec2f getXYCoords(Vec2i pixel, Vec4f window, Vec2i res)
@@ -164,6 +309,39 @@ inline Vec2f getXYCoords(Vec2i pixel, Vec4f window, Vec2i res)
     );
 }
 
+/**
+ * Spreads the lower 16 bits of x so that there is a zero bit between each of them.
+ */
+inline uint32_t spreadBits(uint32_t x)
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+/**
+ * Interleaves the bits of two 16 bit coordinates into a morton (z-order) code.
+ */
+inline uint32_t mortonEncode(uint32_t x, uint32_t y)
+{
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+/**
+ * @return a cheap, monotonically increasing cycle count (time stamp counter on x86, nanoseconds elsewhere)
+ */
+inline uint64_t readCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 inline Vec2i getPixelCoords(Vec2f p, Vec4f window, Vec2i res)
 {
     float dx = window[2] - window[0];
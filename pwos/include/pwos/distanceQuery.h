@@ -0,0 +1,99 @@
+#pragma once
+
+#include <pwos/common.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/scene.h>
+#include <pwos/stats.h>
+
+/**
+ * Distance query policies, used to specialize walk kernels at compile time.
+ *
+ * A policy is called as distance(p, b) and returns the distance from p to the boundary, or a
+ * conservative bound of it. b must be set whenever the returned distance is below BOUNDARY_EPSILON.
+ */
+
+/**
+ * Exact closest point query against every shape in the scene.
+ */
+struct SceneDistance
+{
+    const Scene *scene;
+
+    inline float operator()(Vec2f p, Vec3f &b) const
+    {
+        return (scene->getClosestPoint(p, b) - p).norm();
+    }
+};
+
+/**
+ * Conservative distance read from a closest point grid. Points outside of the grid, or
+ * too close to the boundary for the grid bound to be useful, fall back to an exact query.
+ */
+struct GridDistance
+{
+    const Scene *scene;
+    const ClosestPointGrid *cpg;
+    float minGridR;
+
+    inline float operator()(Vec2f p, Vec3f &b) const
+    {
+        if (cpg->pointInGridRange(p))
+        {
+            float dist, gridDist;
+            cpg->getDistToClosestPoint(p, b, dist, gridDist);
+
+            // conservative distance to nearest boundary
+            float R = dist - gridDist;
+            if (R >= minGridR) return R;
+            Stats::INCREMENT_COUNT(StatType::GRID_FALLBACK);
+        }
+
+        // grid point too close to boundary or not within the grid, do a normal closest point query.
+        return (scene->getClosestPoint(p, b) - p).norm();
+    }
+};
+
+/**
+ * Conservative distance read from a closest point grid without fetching the boundary value (see
+ * ClosestPointGrid::getConservativeDist), for integrators that prefetch or batch their grid lookups.
+ * Points outside of the grid, or too close to the boundary for the bound to be useful, fall back to an exact
+ * query. Only the exact query sets b, which is enough as long as minGridR >= BOUNDARY_EPSILON.
+ */
+struct ConservativeGridDistance
+{
+    const Scene *scene;
+    const ClosestPointGrid *cpg;
+    float minGridR;
+
+    /**
+     * Grid lookup half of the query.
+     *
+     * @param p
+     * @param R     set to the conservative distance if the lookup succeeds
+     *
+     * @return false if p needs an exact query
+     */
+    inline bool bound(Vec2f p, float &R) const
+    {
+        if (!cpg->pointInGridRange(p)) return false;
+        Stats::INCREMENT_COUNT(StatType::GRID_QUERY);
+        R = cpg->getConservativeDist(p);
+        if (R >= minGridR) return true;
+        Stats::INCREMENT_COUNT(StatType::GRID_FALLBACK);
+        return false;
+    }
+
+    /**
+     * Exact closest point query, for points the grid could not handle.
+     */
+    inline float exact(Vec2f p, Vec3f &b) const
+    {
+        return (scene->getClosestPoint(p, b) - p).norm();
+    }
+
+    inline float operator()(Vec2f p, Vec3f &b) const
+    {
+        float R;
+        return bound(p, R) ? R : exact(p, b);
+    }
+};
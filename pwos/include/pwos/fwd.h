@@ -6,4 +6,5 @@ class BBox;
 class Circle;
 class ClosestPointGrid;
 class Image;
+class MappedFile;
 class Scene;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <pwos/common.h>
+#include <pwos/progressBar.h>
+#include <pwos/stats.h>
+#include <pwos/tileScheduler.h>
 
 /**
  * Simple image class, essentially a wrapper around a vector of rgb values
@@ -37,10 +40,47 @@ public:
     Vec3f& operator()(int x, int y);
 
     /**
-     * Helper function for rendering an image.
+     * Helper function for rendering an image. Pixels are rendered tile by tile, tiles are
+     * distributed to the threads by a work-stealing TileScheduler.
      * 
+     * @param window
+     * @param nthreads
+     * @param f             callable f(coord, sampler) returning the value of a pixel, sampler is the PixelSampler of the
+     *                      pixel's samples
+     * @param walksPerPixel random walks f takes per pixel, shown as throughput by the progress bar
      */
-    void render(Vec4f window, int nthreads, Rand2DFunction f);
+    template <typename PixelFunction>
+    void render(Vec4f window, int nthreads, PixelFunction f, int walksPerPixel = 0);
+
+    /**
+     * Helper function for rendering an image where f(coord, sampler, n) returns the sum of n samples
+     * at coord. If there are too few pixels to keep every thread busy, or pixels take many samples, the spp
+     * samples of each pixel are split into chunks that run on different threads. Every sample has its own sampler (see PixelSampler),
+     * the number of chunks does not depend on nthreads and the chunks' partial sums are reduced in a fixed
+     * order, so the result does not depend on the scheduling or the number of threads.
+     * 
+     * @param window
+     * @param nthreads
+     * @param spp       number of samples per pixel
+     * @param f         callable f(coord, sampler, n) returning the sum of n samples at a point, sample j
+     *                  uses sampler.get(j)
+     */
+    template <typename SampleFunction>
+    void render(Vec4f window, int nthreads, int spp, SampleFunction f);
+
+    /**
+     * Set the number of samples per chunk when splitting pixels across threads (0 chooses it automatically).
+     * 
+     * @param sampleChunkSize
+     */
+    void setSampleChunkSize(int sampleChunkSize);
+
+    /**
+     * Set the width and height (in pixels) of the tiles used by render.
+     * 
+     * @param tileSize
+     */
+    void setTileSize(int tileSize);
 
     /**
      * Save the image as an HDR image.
@@ -49,6 +89,22 @@ public:
      */
     void save(string filename);
 
+    /**
+     * Save the image losslessly as raw floats (resolution followed by the RGB values), e.g. to cache a reference.
+     * 
+     * @param filename
+     */
+    void saveRaw(string filename);
+
+    /**
+     * Load an image written by saveRaw, the resolution must match.
+     * 
+     * @param filename
+     * 
+     * @return false if the file could not be opened
+     */
+    bool loadRaw(string filename);
+
     /**
      * Returns the resolution of the image
      * 
@@ -78,4 +134,108 @@ private:
 
     // resolution of the image
     Vec2i res;
+
+    // width and height of the tiles used when rendering
+    int tileSize = 16;
+
+    // samples per chunk when a pixel's samples are split across threads (0 = automatic)
+    int sampleChunkSize = 0;
 };
+
+// the automatic sample chunking, independent of the number of threads: pixels are split until there are
+// at least MIN_RENDER_TASKS tasks (enough for 64 threads to get 16 each) and into chunks of at most
+// AUTO_SAMPLE_CHUNK_SIZE samples, unless that makes more than MAX_RENDER_TASKS tasks (their partial sums are stored)
+constexpr int MIN_RENDER_TASKS = 1024;
+constexpr int MAX_RENDER_TASKS = 1 << 20;
+constexpr int AUTO_SAMPLE_CHUNK_SIZE = 1024;
+
+template <typename PixelFunction>
+void Image::render(Vec4f window, int nthreads, PixelFunction f, int walksPerPixel)
+{   
+    ProgressBar progress;
+    progress.start(getNumPixels(), walksPerPixel);
+
+    TileScheduler scheduler(res, tileSize, nthreads);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        size_t tid = omp_get_thread_num();
+        Vec4i tile;
+        while (scheduler.next(tid, tile))
+        {
+Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &tile, &f, window]() -> void {
+            for (int y = tile[1]; y < tile[3]; y++)
+            {
+                for (int x = tile[0]; x < tile[2]; x++)
+                {
+                    Vec2f coord = getXYCoords(Vec2i(x, y), window, res);
+                    (*this)(x, y) = f(coord, PixelSampler{y * res.x() + x, 0});
+                }
+            }
+});
+            progress += (tile[2] - tile[0]) * (tile[3] - tile[1]);
+        }
+    }
+    progress.finish();
+}
+
+template <typename SampleFunction>
+void Image::render(Vec4f window, int nthreads, int spp, SampleFunction f)
+{
+    int numPixels = getNumPixels();
+
+    // split pixels into enough chunks that every thread gets plenty of tasks
+    int nChunks;
+    if (sampleChunkSize > 0)
+    {
+        nChunks = (spp + sampleChunkSize - 1) / sampleChunkSize;
+    }
+    else
+    {
+        nChunks = std::max((MIN_RENDER_TASKS + numPixels - 1) / numPixels, (spp + AUTO_SAMPLE_CHUNK_SIZE - 1) / AUTO_SAMPLE_CHUNK_SIZE);
+        nChunks = std::min(nChunks, MAX_RENDER_TASKS / std::max(numPixels, 1));
+    }
+    nChunks = std::clamp(nChunks, 1, std::max(spp, 1));
+
+    if (nChunks == 1)
+    {
+        render(window, nthreads, [&f, spp](Vec2f coord, const PixelSampler &sampler) -> Vec3f
+        {
+            return f(coord, sampler, spp) / float(spp);
+        }, spp);
+        return;
+    }
+
+    int numTasks = numPixels * nChunks;
+    vector<Vec3f> partialSums(numTasks);
+
+    ProgressBar progress;
+    progress.start(numTasks, double(spp) / nChunks);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+    for (int task = 0; task < numTasks; task++)
+    {
+Stats::TIME_THREAD(StatTimerType::TOTAL, [this, task, nChunks, spp, &f, window, &partialSums]() -> void {
+        int i = task / nChunks;
+        int chunk = task % nChunks;
+        int firstSample = (long(spp) * chunk) / nChunks;
+        int nSamples = (long(spp) * (chunk + 1)) / nChunks - firstSample;
+
+        Vec2f coord = getXYCoords(getPixelCoordinates(i), window, res);
+        partialSums[task] = f(coord, PixelSampler{i, firstSample}, nSamples);
+});
+        progress++;
+    }
+    progress.finish();
+
+    // reduce in chunk order
+    for (int i = 0; i < numPixels; i++)
+    {
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (int chunk = 0; chunk < nChunks; chunk++)
+        {
+            sum += partialSums[i * nChunks + chunk];
+        }
+        set(i, sum / float(spp));
+    }
+}
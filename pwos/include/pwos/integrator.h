@@ -12,12 +12,12 @@ public:
      * Default constructor for an integrator.
      *
      * @param name      name of the integrator 
-     * @param scene     scene to render
+     * @param scene     scene to render (shared, never copied)
      * @param res       resolution of image created
      * @param spp       number of samples to use per pixel
      * @param nthreads  max number of threads to use at any stage of integration (pre-processing or rendering)
      */
-    Integrator(string name, Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1);
+    Integrator(string name, shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1);
 
     /**
      * Renders a scene and saves intermediate result within integrator (under img.)
@@ -29,6 +29,25 @@ public:
      */
     void save();
 
+    /**
+     * @return the image produced by calling render
+     */
+    shared_ptr<Image> getImage();
+
+    /**
+     * Set the size of the tiles the image is split into when rendering pixels in parallel.
+     * 
+     * @param tileSize  width and height of a tile in pixels
+     */
+    void setTileSize(int tileSize);
+
+    /**
+     * Set the number of samples per chunk when a pixel's samples are split across threads.
+     * 
+     * @param sampleChunkSize   samples per chunk (0 chooses the chunk size automatically)
+     */
+    void setSampleChunkSize(int sampleChunkSize);
+
 protected:
     // name of the integrator
     string name;
@@ -40,8 +59,56 @@ protected:
     int spp;
 
     // scene geometry and boundary conditions
-    shared_ptr<Scene> scene;
+    shared_ptr<const Scene> scene;
 
     // image stored after running render
     shared_ptr<Image> image;
-};
\ No newline at end of file
+};
+
+/**
+ * Create an integrator by name.
+ *
+ * @param type          name of the integrator (see StrToIntegratorType)
+ * @param scene         scene to render
+ * @param res           resolution of the image
+ * @param spp           number of samples per pixel
+ * @param nthreads      number of threads
+ * @param cellSize      relative size of the grid cells (integrators with a closest point grid)
+ * @param sortWalks     sort each round of walks by morton code (mcwog)
+ *
+ * @return the integrator
+ */
+shared_ptr<Integrator> buildIntegrator(string type, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, float cellSize, bool sortWalks);
+
+/**
+ * Settings of a render that do not change its result, on top of the integrator type, resolution, spp and threads.
+ */
+struct RenderOptions
+{
+    // relative size of the grid cells (integrators with a closest point grid)
+    float cellSize = 1;
+
+    // sort each round of walks by morton code (mcwog)
+    bool sortWalks = false;
+
+    // width and height of the tiles rendered by the threads
+    int tileSize = 16;
+
+    // samples per chunk when a pixel's samples are split across threads (0 chooses it automatically)
+    int sampleChunkSize = 0;
+};
+
+/**
+ * Build an integrator and render the scene with it, the way pwos and the benchmark harnesses do. Counts
+ * the walks and times the setup, render and total in Stats, which the caller has to initialize.
+ *
+ * @param type          name of the integrator (see StrToIntegratorType)
+ * @param scene         scene to render
+ * @param res           resolution of the image
+ * @param spp           number of samples per pixel
+ * @param nthreads      number of threads
+ * @param options
+ *
+ * @return the integrator, holding the rendered image
+ */
+shared_ptr<Integrator> buildAndRender(string type, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, const RenderOptions &options);
@@ -9,13 +9,13 @@
 class Distance: public Integrator
 {
 public:
-    Distance(Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1)
+    Distance(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1)
     : Integrator("dist", scene, res, spp, nthreads)
     {};
 
     void virtual render() override
     {
-        image->render(scene->getWindow(), nthreads, [this](Vec2f coord, pcg32& _) -> Vec3f
+        image->render(scene->getWindow(), nthreads, [this](Vec2f coord, const PixelSampler &_) -> Vec3f
         {
             Vec3f b;
             float dist = (scene->getClosestPoint(coord, b) - coord).norm();
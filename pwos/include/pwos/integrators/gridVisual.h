@@ -12,7 +12,7 @@ class GridVisual: public Integrator
 public:
     shared_ptr<ClosestPointGrid> cpg;
 
-    GridVisual(Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    GridVisual(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
     : Integrator("gridviz", scene, res, spp, nthreads) 
     {
         // preprocess by computing closest point grid
@@ -29,7 +29,7 @@ public:
 
     void virtual render() override
     {
-        image->render(scene->getWindow(), nthreads, [this](Vec2f coord, pcg32& _) -> Vec3f
+        image->render(scene->getWindow(), nthreads, [this](Vec2f coord, const PixelSampler &_) -> Vec3f
         {
             if (cpg->pointInGridRange(coord))
             {
@@ -8,6 +8,8 @@
 #include <pwos/closestPointGrid.h>
 #include <pwos/randomWalk.h>
 #include <pwos/progressBar.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
 
 class MCWoG: public Integrator
 {
@@ -16,14 +18,18 @@ public:
     int ncols, nrows;
     float rrProb = 0.99;
     int numUsableThreads;
+
+    // sort each round's active walks by morton code of their position before advancing them
+    bool sortWalks;
     shared_ptr<ClosestPointGrid> cpg;
     shared_ptr<RandomWalkManager> sharedRWM;
 
-    MCWoG(Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    MCWoG(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1, bool sortWalks = false)
     : Integrator("mcwog", scene, res, spp, nthreads)
+    , sortWalks(sortWalks)
     {
         // Set the dimensions of the grid/region that each thread is responsible for
-        Vec4f window = scene.getWindow();
+        Vec4f window = scene->getWindow();
         Vec2f bl(window[0], window[1]);
         Vec2f tr(window[2], window[3]);
         float dx = tr.x() - bl.x();
@@ -47,32 +53,38 @@ public:
     void virtual render() override
     {
         ProgressBar progress;
-        progress.start(image->getNumPixels());
+        progress.start(image->getNumPixels(), spp);
         int walksRemaining = image->getNumPixels();
         #pragma omp parallel num_threads(numUsableThreads)
         {
 Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &progress, &walksRemaining]() -> void {
+            auto kernel = makeWalkKernel(GridDistance{scene.get(), cpg.get(), minGridR}, rrProb, WalkStatistics{scene->getWindow()});
             size_t tid = omp_get_thread_num();
-            pcg32 sampler = getSampler(tid);
             std::shared_ptr<RandomWalkManager> rwm = (tid == 0)
                 ? sharedRWM
                 : make_shared<RandomWalkManager>(sharedRWM, tid);
 
             vector<shared_ptr<RandomWalk>> readyToWrite;
-            while (true)
+            for (int round = 0; true; round++)
             {
+                Trace::Scope scope("round", round);
+
                 // advance existing walks
                 vector<shared_ptr<RandomWalk>> activeRandomWalks = rwm->recvActiveWalks();
-                for (int i = 0; i < activeRandomWalks.size(); i++)
+                if (sortWalks) sortByMortonCode(activeRandomWalks, cpg);
+                for (size_t i = 0; i < activeRandomWalks.size(); i++)
                 {
                     shared_ptr<RandomWalk> rw = activeRandomWalks[i];
-                    advanceWalk(scene, rw, cpg, sampler, minGridR, rrProb);
+
+                    // start loading the next walk's grid cell while this one is advanced
+                    if (i + 1 < activeRandomWalks.size()) cpg->prefetch(activeRandomWalks[i + 1]->p);
+                    kernel.advance(*rw);
                     rwm->addWalkToBuffer(rw);
                 }
 
                 // process finished walks
                 vector<shared_ptr<RandomWalk>> terminatedRandomWalks = rwm->recvTerminatedWalks();
-                for (int i = 0; i < terminatedRandomWalks.size(); i++)
+                for (size_t i = 0; i < terminatedRandomWalks.size(); i++)
                 {
                     shared_ptr<RandomWalk> rw = terminatedRandomWalks[i];
                     if (rw ->nSamplesLeft == 0)
@@ -109,44 +121,27 @@ Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &progress, &walksRemaining]() ->
     }
 
 private:
-    inline static void advanceWalk(shared_ptr<Scene> scene, shared_ptr<RandomWalk> rw, shared_ptr<ClosestPointGrid> cpg, pcg32 &sampler, float minGridR, float rrProb)
+    /**
+     * Sort random walks by the morton code of the grid cell they are in, so that
+     * consecutive grid lookups hit nearby (and likely cached) cells.
+     * 
+     * @param rws       random walks to sort
+     * @param cpg       grid used to compute the morton codes
+     */
+    inline static void sortByMortonCode(vector<shared_ptr<RandomWalk>> &rws, shared_ptr<ClosestPointGrid> cpg)
     {
-        Vec2f p = rw->p;
-        Vec3f b;
-        float R, dist, gridDist; 
-
-        if (cpg->pointInGridRange(p))
-        {
-            cpg->getDistToClosestPoint(p, b, dist, gridDist);
-
-            // conservative distance to nearest boundary
-            R = dist - gridDist;
-            if (R < minGridR)
-            {
-                // grid point too close to boundary, just do our own cpq
-                R = (scene->getClosestPoint(p, b) - p).norm();
-            }
-        }
-        else
+        vector<std::pair<uint32_t, shared_ptr<RandomWalk>>> keyed;
+        keyed.reserve(rws.size());
+        for (shared_ptr<RandomWalk> &rw : rws)
         {
-            // if we end up here, the point is not within the grid do a normal closest point query.
-            R = (scene->getClosestPoint(p, b) - p).norm();
+            keyed.emplace_back(cpg->getMortonCode(rw->p), std::move(rw));
         }
 
-        if (R < BOUNDARY_EPSILON)
-        {
-            // within epsilon of boundary, terminate walk
-            rw->terminate(b);
-        }
-        else if (sampler.nextFloat() < (1.0f - rrProb))
-        {
-            // walk terminated due to russian roulette (value is set to 0)
-            rw->terminate(Vec3f(0.0f, 0.0f, 0.0f));
-        }
-        else
+        std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        for (size_t i = 0; i < keyed.size(); i++)
         {
-            // walk continues, take another step
-            rw->takeStep(sampleCirclePoint(R, sampler.nextFloat()), 1.0f / rrProb);
+            rws[i] = std::move(keyed[i].second);
         }
     }
 };
@@ -8,6 +8,8 @@
 #include <pwos/closestPointGrid.h>
 #include <pwos/randomWalk.h>
 #include <pwos/progressBar.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
 
 class MCWoGVisual: public Integrator
 {
@@ -20,11 +22,11 @@ public:
     shared_ptr<RandomWalkManager> sharedRWM;
     shared_ptr<Image> heatMap;
 
-    MCWoGVisual(Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    MCWoGVisual(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
     : Integrator("mcwog", scene, res, spp, nthreads)
     {
         // Set the dimensions of the grid/region that each thread is responsible for
-        Vec4f window = scene.getWindow();
+        Vec4f window = scene->getWindow();
         Vec2f bl(window[0], window[1]);
         Vec2f tr(window[2], window[3]);
         float dx = tr.x() - bl.x();
@@ -50,13 +52,14 @@ public:
     void virtual render() override
     {
         ProgressBar progress;
-        progress.start(image->getNumPixels());
+        progress.start(image->getNumPixels(), spp);
         int walksRemaining = image->getNumPixels();
         #pragma omp parallel num_threads(numUsableThreads)
         {
 Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &progress, &walksRemaining]() -> void {
+            GridHeatMap gridHeatMap{heatMap.get(), cpg.get(), scene->getWindow()};
+            auto kernel = makeWalkKernel(GridDistance{scene.get(), cpg.get(), minGridR}, rrProb, gridHeatMap);
             size_t tid = omp_get_thread_num();
-            pcg32 sampler = getSampler(tid);
             std::shared_ptr<RandomWalkManager> rwm = (tid == 0)
                 ? sharedRWM
                 : make_shared<RandomWalkManager>(sharedRWM, tid);
@@ -69,7 +72,7 @@ Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &progress, &walksRemaining]() ->
                 for (int i = 0; i < activeRandomWalks.size(); i++)
                 {
                     shared_ptr<RandomWalk> rw = activeRandomWalks[i];
-                    advanceWalk(heatMap, scene, rw, cpg, sampler, minGridR, rrProb);
+                    kernel.advance(*rw);
                     rwm->addWalkToBuffer(rw);
                 }
 
@@ -111,55 +114,4 @@ Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &progress, &walksRemaining]() ->
         progress.finish();
         heatMap->save("mc-wog-heatmap");
     }
-
-private:
-    inline static void advanceWalk(shared_ptr<Image> heatMap, shared_ptr<Scene> scene, shared_ptr<RandomWalk> rw, shared_ptr<ClosestPointGrid> cpg, pcg32 &sampler, float minGridR, float rrProb)
-    {
-        Vec2f p = rw->p;
-        Vec3f b;
-        float R, dist, gridDist; 
-
-        if (cpg->pointInGridRange(p))
-        {
-            cpg->getDistToClosestPoint(p, b, dist, gridDist);
-
-             // mark heat map where grid was touched
-            if (omp_get_thread_num() == 0)
-            {
-                Vec2i g = cpg->getGridCoordinates(p);
-                Vec2f gp = cpg->getGridPointCoordinates(g);
-                Vec2i pxy = getPixelCoords(gp, scene->getWindow(), heatMap->getRes());
-                heatMap->operator()(pxy.x(), pxy.y()) = Vec3f(1.0f, 1.0f, 1.0f);
-            }
-
-            // conservative distance to nearest boundary
-            R = dist - gridDist;
-            if (R < minGridR)
-            {
-                // grid point too close to boundary, just do our own cpq
-                R = (scene->getClosestPoint(p, b) - p).norm();
-            }
-        }
-        else
-        {
-            // if we end up here, the point is not within the grid do a normal closest point query.
-            R = (scene->getClosestPoint(p, b) - p).norm();
-        }
-
-        if (R < BOUNDARY_EPSILON)
-        {
-            // within epsilon of boundary, terminate walk
-            rw->terminate(b);
-        }
-        else if (sampler.nextFloat() < (1.0f - rrProb))
-        {
-            // walk terminated due to russian roulette (value is set to 0)
-            rw->terminate(Vec3f(0.0f, 0.0f, 0.0f));
-        }
-        else
-        {
-            // walk continues, take another step
-            rw->takeStep(sampleCirclePoint(R, sampler.nextFloat()), 1.0f / rrProb);
-        }
-    }
 };
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <pwos/common.h>
+
+#include <pwos/image.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/progressBar.h>
+#include <pwos/stats.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
+
+/**
+ * In-flight walks of one thread, stored as SoA arrays and indexed through compacted queues.
+ */
+struct WalkWavefront
+{
+    // walk state (one entry per slot)
+    vector<float> px, py, R, f;
+    vector<int> pixel, sample, nSteps;
+    vector<Vec3f> b;
+    vector<pcg32> sampler;
+
+    // slots that can take a new walk
+    vector<int> freeSlots;
+
+    // stage queues, each holds the slots that have to be processed by that stage
+    vector<int> active, exact, step, hit, killed;
+
+    /**
+     * Allocate a wavefront.
+     *
+     * @param size      max number of walks in flight
+     */
+    WalkWavefront(int size)
+    : px(size), py(size), R(size), f(size), pixel(size), sample(size), nSteps(size), b(size), sampler(size)
+    {
+        freeSlots.reserve(size);
+        for (int i = size - 1; i >= 0; i--) freeSlots.push_back(i);
+        active.reserve(size);
+        exact.reserve(size);
+        step.reserve(size);
+        hit.reserve(size);
+        killed.reserve(size);
+    }
+};
+
+/**
+ * Walk on grids organized as a wavefront: every thread keeps a wavefront of walks in flight and
+ * advances them stage by stage (generate, grid lookup, exact query fallback, sample step, terminate/accumulate),
+ * each stage running as a tight loop over its own queue.
+ */
+class Wavefront: public Integrator
+{
+public:
+    float rrProb = 0.99;
+    float cellLength, minGridR;
+    int wavefrontSize = 4096;
+    shared_ptr<ClosestPointGrid> cpg;
+
+    Wavefront(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    : Integrator("wavefront", scene, res, spp, nthreads)
+    {
+        // preprocess by computing closest point grid
+        Vec4f window = this->scene->getWindow();
+        Vec2f bl(window[0], window[1]);
+        Vec2f tr(window[2], window[3]);
+        float dx = tr.x() - bl.x();
+        float dy = tr.y() - bl.y();
+
+        // ensures cells are basically width of a pixel
+        // precompute grid
+        cellLength = cellSize * std::min(dx / res.x(), dy / res.y());
+        minGridR = BOUNDARY_EPSILON;
+        cpg = make_shared<ClosestPointGrid>(this->scene, bl, tr, cellLength, nthreads);
+    };
+
+    void virtual render() override
+    {
+        int numPixels = image->getNumPixels();
+        Vec4f window = scene->getWindow();
+        Vec2i res = image->getRes();
+
+        // values of the walks of pixels in flight and the number of walks still in flight / to generate per pixel.
+        // a pixel is generated entirely by one thread, so its entries are only touched by that thread.
+        // walks of a pixel finish in an order that depends on the other walks in the wavefront, their values
+        // are summed in sample order once the pixel is done so that the result does not depend on it.
+        vector<vector<Vec3f>> values(numPixels);
+        vector<int> walksLeft(numPixels, spp);
+        int nextPixel = 0;
+
+        ProgressBar progress;
+        progress.start(numPixels, spp);
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &values, &walksLeft, &nextPixel, &progress, numPixels, window, res]() -> void {
+            WalkWavefront wf(wavefrontSize);
+            auto kernel = makeWalkKernel(ConservativeGridDistance{scene.get(), cpg.get(), minGridR}, rrProb, WalkStatistics{window});
+
+            // pixel currently being generated, the number of its walks not yet generated and the first
+            // distance query of its walks (the same for every walk, so it is done once)
+            int genPixel = -1, genLeft = 0;
+            bool generating = true;
+            Vec2f genCoord;
+            Vec3f genB;
+            float genR = 0.0f;
+
+            while (true)
+            {
+                // generate: fill free slots with new walks
+                while (generating && !wf.freeSlots.empty())
+                {
+                    if (genLeft == 0)
+                    {
+                        #pragma omp atomic capture
+                        genPixel = nextPixel++;
+                        if (genPixel >= numPixels)
+                        {
+                            generating = false;
+                            break;
+                        }
+                        genCoord = getXYCoords(image->getPixelCoordinates(genPixel), window, res);
+                        genR = kernel.query(genCoord, genB);
+                        if (genR < BOUNDARY_EPSILON)
+                        {
+                            for (int j = 0; j < spp; j++) kernel.instrumentation.onWalkEnd(genCoord, StepResult::HIT_BOUNDARY, 1);
+                            // every walk hits the boundary right away
+                            image->set(genPixel, genB);
+                            walksLeft[genPixel] = 0;
+                            progress++;
+                            continue;
+                        }
+                        genLeft = spp;
+                        values[genPixel].resize(spp);
+                    }
+                    int slot = wf.freeSlots.back();
+                    wf.freeSlots.pop_back();
+                    wf.px[slot] = genCoord.x();
+                    wf.py[slot] = genCoord.y();
+                    wf.f[slot] = 1.0f;
+                    wf.pixel[slot] = genPixel;
+                    wf.sample[slot] = spp - genLeft;
+                    wf.nSteps[slot] = 1;
+                    wf.sampler[slot] = getSampler(genPixel, spp - genLeft);
+                    wf.R[slot] = genR;
+                    wf.step.push_back(slot);
+                    genLeft--;
+                }
+                if (wf.active.empty() && wf.step.empty()) break;
+
+                // grid lookup: conservative radius for walks in the grid, everything else needs an exact query
+                for (int slot : wf.active)
+                {
+                    if (kernel.boundQuery(Vec2f(wf.px[slot], wf.py[slot]), wf.R[slot])) wf.step.push_back(slot);
+                    else wf.exact.push_back(slot);
+                }
+                wf.active.clear();
+
+                // exact query fallback
+                for (int slot : wf.exact)
+                {
+                    Vec2f p(wf.px[slot], wf.py[slot]);
+                    wf.R[slot] = kernel.exactQuery(p, wf.b[slot]);
+                    if (wf.R[slot] < BOUNDARY_EPSILON) wf.hit.push_back(slot);
+                    else wf.step.push_back(slot);
+                }
+                wf.exact.clear();
+
+                // sample step: russian roulette, then move to a random point on the sphere
+                Vec2f stepVec(0.0f, 0.0f);
+                float fUpdate = 1.0f;
+                for (int slot : wf.step)
+                {
+                    if (kernel.step(wf.R[slot], wf.sampler[slot], stepVec, fUpdate) == StepResult::RUSSIAN_ROULETTE)
+                    {
+                        wf.killed.push_back(slot);
+                        continue;
+                    }
+                    wf.f[slot] *= fUpdate;
+                    wf.px[slot] += stepVec.x();
+                    wf.py[slot] += stepVec.y();
+                    wf.nSteps[slot]++;
+                    wf.active.push_back(slot);
+                }
+                wf.step.clear();
+
+                // terminate/accumulate: record boundary values, release slots and finish pixels
+                for (int slot : wf.hit)
+                {
+                    kernel.instrumentation.onWalkEnd(Vec2f(wf.px[slot], wf.py[slot]), StepResult::HIT_BOUNDARY, wf.nSteps[slot]);
+                    values[wf.pixel[slot]][wf.sample[slot]] = wf.f[slot] * wf.b[slot];
+                }
+                for (int slot : wf.killed)
+                {
+                    kernel.instrumentation.onWalkEnd(Vec2f(wf.px[slot], wf.py[slot]), StepResult::RUSSIAN_ROULETTE, wf.nSteps[slot]);
+                    values[wf.pixel[slot]][wf.sample[slot]] = Vec3f(0.0f, 0.0f, 0.0f);
+                }
+                wf.hit.insert(wf.hit.end(), wf.killed.begin(), wf.killed.end());
+                for (int slot : wf.hit)
+                {
+                    int pixel = wf.pixel[slot];
+                    if (--walksLeft[pixel] == 0)
+                    {
+                        Vec3f sum(0.0f, 0.0f, 0.0f);
+                        for (Vec3f value : values[pixel]) sum += value;
+                        image->set(pixel, sum / float(spp));
+                        vector<Vec3f>().swap(values[pixel]);
+                        progress++;
+                    }
+                    wf.freeSlots.push_back(slot);
+                }
+                wf.hit.clear();
+                wf.killed.clear();
+            }
+});
+        }
+        progress.finish();
+    }
+};
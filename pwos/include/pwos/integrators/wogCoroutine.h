@@ -0,0 +1,161 @@
+#pragma once
+
+#include <pwos/common.h>
+
+#include <pwos/image.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/progressBar.h>
+#include <pwos/stats.h>
+#include <pwos/walkTask.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
+
+/**
+ * Walk on grids where every pixel estimate is a coroutine. Before each grid lookup the walk
+ * prefetches the grid cell and suspends, each thread interleaves many pixels round-robin so
+ * that the cache misses of different walks overlap.
+ */
+class WoGCoroutine: public Integrator
+{
+public:
+    float rrProb = 0.99;
+    float cellLength, minGridR;
+
+    // number of pixels each thread keeps in flight
+    int tasksPerThread = 32;
+    shared_ptr<ClosestPointGrid> cpg;
+
+    WoGCoroutine(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    : Integrator("wogcoro", scene, res, spp, nthreads)
+    {
+        // preprocess by computing closest point grid
+        Vec4f window = this->scene->getWindow();
+        Vec2f bl(window[0], window[1]);
+        Vec2f tr(window[2], window[3]);
+        float dx = tr.x() - bl.x();
+        float dy = tr.y() - bl.y();
+
+        // ensures cells are basically width of a pixel
+        // precompute grid
+        cellLength = cellSize * std::min(dx / res.x(), dy / res.y());
+        minGridR = BOUNDARY_EPSILON;
+        cpg = make_shared<ClosestPointGrid>(this->scene, bl, tr, cellLength, nthreads);
+    };
+
+    void virtual render() override
+    {
+        int numPixels = image->getNumPixels();
+        int nextPixel = 0;
+
+        ProgressBar progress;
+        progress.start(numPixels, spp);
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+Stats::TIME_THREAD(StatTimerType::TOTAL, [this, &nextPixel, &progress, numPixels]() -> void {
+            Vec4f window = scene->getWindow();
+            Vec2i res = image->getRes();
+
+            vector<WalkTask> tasks(tasksPerThread);
+            vector<int> taskPixel(tasksPerThread);
+
+            // start a new pixel in slot i, returns false once there are no pixels left
+            auto launch = [&](int i) -> bool
+            {
+                int pixel;
+                #pragma omp atomic capture
+                pixel = nextPixel++;
+                if (pixel >= numPixels) return false;
+                taskPixel[i] = pixel;
+                tasks[i] = estimatePixel(getXYCoords(image->getPixelCoordinates(pixel), window, res), pixel);
+                return true;
+            };
+
+            int nInFlight = 0;
+            for (int i = 0; i < tasksPerThread; i++)
+            {
+                if (!launch(i)) break;
+                nInFlight++;
+            }
+
+            // round robin over the pixels in flight
+            while (nInFlight > 0)
+            {
+                for (int i = 0; i < tasksPerThread; i++)
+                {
+                    if (!tasks[i].valid()) continue;
+                    tasks[i].resume();
+                    if (!tasks[i].done()) continue;
+
+                    image->set(taskPixel[i], tasks[i].result() / float(spp));
+                    progress++;
+                    if (!launch(i))
+                    {
+                        tasks[i] = WalkTask();
+                        nInFlight--;
+                    }
+                }
+            }
+});
+        }
+        progress.finish();
+    }
+
+private:
+    /**
+     * Sum of spp walks started at x0, suspends after prefetching each grid lookup. Like WalkKernel::estimate,
+     * the first distance query is the same for every walk, so it is done once.
+     *
+     * @param x0        starting point of the walks
+     * @param pixel     index of the pixel, selects the walks' samplers
+     */
+    WalkTask estimatePixel(Vec2f x0, int pixel) const
+    {
+        auto kernel = makeWalkKernel(ConservativeGridDistance{scene.get(), cpg.get(), minGridR}, rrProb, WalkStatistics{scene->getWindow()});
+        if (cpg->pointInGridRange(x0))
+        {
+            cpg->prefetch(x0);
+            co_await YieldToScheduler{};
+        }
+        Vec3f b0;
+        float R0 = kernel.query(x0, b0);
+        if (R0 < BOUNDARY_EPSILON)
+        {
+            for (int j = 0; j < spp; j++) kernel.instrumentation.onWalkEnd(x0, StepResult::HIT_BOUNDARY, 1);
+            co_return b0 * float(spp);
+        }
+
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (int j = 0; j < spp; j++)
+        {
+            pcg32 sampler = getSampler(pixel, j);
+            Vec2f p = x0;
+            Vec3f b = b0;
+            float R = R0;
+            float f = 1.0f;
+            Vec2f stepVec(0.0f, 0.0f);
+            float fUpdate = 1.0f;
+            StepResult result;
+            int nSteps = 1;
+            while ((result = kernel.step(R, sampler, stepVec, fUpdate)) == StepResult::CONTINUE)
+            {
+                f *= fUpdate;
+                p += stepVec;
+                nSteps++;
+
+                if (cpg->pointInGridRange(p))
+                {
+                    cpg->prefetch(p);
+                    co_await YieldToScheduler{};
+                }
+                R = kernel.query(p, b);
+            }
+
+            kernel.instrumentation.onWalkEnd(p, result, nSteps);
+            if (result == StepResult::HIT_BOUNDARY) sum += f * b;
+        }
+        co_return sum;
+    }
+};
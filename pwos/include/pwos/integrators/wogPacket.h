@@ -0,0 +1,63 @@
+#pragma once
+
+#include <pwos/common.h>
+
+#include <pwos/image.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/stats.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
+#include <pwos/walkPacket.h>
+
+/**
+ * Walk on grids that advances PACKET_WIDTH samples of a pixel in lockstep. Grid lookups
+ * are vectorized across the packet, lanes that need an exact closest point query fall back to the scene.
+ */
+class WoGPacket: public Integrator
+{
+public:
+    float rrProb = 0.99;
+    float cellLength, minGridR;
+    shared_ptr<ClosestPointGrid> cpg;
+
+    WoGPacket(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    : Integrator("wogpacket", scene, res, spp, nthreads)
+    {
+        // preprocess by computing closest point grid
+        Vec4f window = this->scene->getWindow();
+        Vec2f bl(window[0], window[1]);
+        Vec2f tr(window[2], window[3]);
+        float dx = tr.x() - bl.x();
+        float dy = tr.y() - bl.y();
+
+        // ensures cells are basically width of a pixel
+        // precompute grid
+        cellLength = cellSize * std::min(dx / res.x(), dy / res.y());
+        minGridR = BOUNDARY_EPSILON;
+        cpg = make_shared<ClosestPointGrid>(this->scene, bl, tr, cellLength, nthreads);
+    };
+
+    void virtual render() override
+    {
+        auto kernel = makeWalkKernel(ConservativeGridDistance{scene.get(), cpg.get(), minGridR}, rrProb, WalkStatistics{scene->getWindow()});
+        image->render(scene->getWindow(), nthreads, spp, [this, &kernel](Vec2f coord, const PixelSampler &sampler, int nSamples) -> Vec3f
+        {
+            WalkPacket packet;
+            return packet.estimate(coord, nSamples, sampler, kernel, [this, &kernel](WalkPacket &packet) -> void
+            {
+                int nFallbacks;
+                Stats::ADD_COUNT(StatType::GRID_QUERY, packet.gridLookup(*cpg, minGridR, nFallbacks));
+                Stats::ADD_COUNT(StatType::GRID_FALLBACK, nFallbacks);
+
+                // lanes the grid could not handle do a normal closest point query
+                for (int k = 0; k < PACKET_WIDTH; k++)
+                {
+                    if (!packet.exact[k]) continue;
+                    packet.R[k] = kernel.exactQuery(Vec2f(packet.px[k], packet.py[k]), packet.b[k]);
+                }
+            });
+        });
+    }
+};
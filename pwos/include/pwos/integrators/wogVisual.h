@@ -6,6 +6,8 @@
 #include <pwos/integrator.h>
 #include <pwos/scene.h>
 #include <pwos/closestPointGrid.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
 
 class WoGVisual: public Integrator
 {
@@ -15,7 +17,7 @@ public:
     shared_ptr<ClosestPointGrid> cpg;
     shared_ptr<Image> heatMap;
 
-    WoGVisual(Scene scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
+    WoGVisual(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1, float cellSize = 1)
     : Integrator("wog", scene, res, spp, nthreads)
     {
         // preprocess by computing closest point grid
@@ -35,62 +37,12 @@ public:
 
     void virtual render() override
     {
-        image->render(scene->getWindow(), nthreads, [this](Vec2f coord, pcg32& sampler) -> Vec3f
+        GridHeatMap gridHeatMap{heatMap.get(), cpg.get(), scene->getWindow()};
+        auto kernel = makeWalkKernel(GridDistance{scene.get(), cpg.get(), minGridR}, rrProb, gridHeatMap);
+        image->render(scene->getWindow(), nthreads, spp, [&kernel](Vec2f coord, const PixelSampler &sampler, int nSamples) -> Vec3f
         {
-            Vec3f pixelValue(0, 0, 0);
-            for (int j = 0; j < spp; j++)
-            {
-                pixelValue += u_hat(coord, sampler);
-            }
-            return pixelValue / float(spp);
+            return kernel.estimate(coord, nSamples, sampler);
         });
         heatMap->save("wog-heatmap");
     }
-
-private:
-    Vec3f u_hat(Vec2f x0, pcg32 &sampler) const
-    {
-        Vec2f p = x0;
-        Vec3f b;
-        float R, dist, gridDist;
-        float f = 1.0f;
-        do
-        {
-            if (cpg->pointInGridRange(p))
-            {
-                cpg->getDistToClosestPoint(p, b, dist, gridDist);
-
-                // mark heat map where grid was touched
-                if (omp_get_thread_num() == 0)
-                {
-                    Vec2i g =cpg->getGridCoordinates(p);
-                    Vec2f gp = cpg->getGridPointCoordinates(g);
-                    Vec2i pxy = getPixelCoords(gp, scene->getWindow(), heatMap->getRes());
-                    heatMap->operator()(pxy.x(), pxy.y()) = Vec3f(1.0f, 1.0f, 1.0f);
-                }
-
-                // conservative distance to nearest boundary
-                R = dist - gridDist;
-                if (R < minGridR)
-                {
-                    // grid point too close to boundary, just do our own cpq
-                    R = (scene->getClosestPoint(p, b) - p).norm();
-                    if (R < BOUNDARY_EPSILON) break;
-                }
-            }
-            else
-            {
-                // if we end up here, the point is not within the grid. do a normal closest point query.
-                R = (scene->getClosestPoint(p, b) - p).norm();
-                if (R < BOUNDARY_EPSILON) break;
-            }
-
-            if (sampler.nextFloat() < (1.0f - rrProb)) break;
-            f /= rrProb;
-            p += sampleCirclePoint(R, sampler.nextFloat());
-        }
-        while (true);
-
-        return R < BOUNDARY_EPSILON ? b : Vec3f(0, 0, 0); 
-    }
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pwos/common.h>
+
+#include <pwos/image.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/walkKernel.h>
+#include <pwos/walkPacket.h>
+
+/**
+ * Walk on spheres that advances PACKET_WIDTH samples of a pixel in lockstep.
+ */
+class WoSPacket: public Integrator
+{
+public:
+    WoSPacket(shared_ptr<const Scene> scene, Vec2i res = Vec2i(128, 128), int spp = 16, int nthreads = 1)
+    : Integrator("wospacket", scene, res, spp, nthreads) 
+    {};
+
+    void virtual render() override
+    {
+        auto kernel = makeWalkKernel(SceneDistance{scene.get()}, rrProb, WalkStatistics{scene->getWindow()});
+        image->render(scene->getWindow(), nthreads, spp, [&kernel](Vec2f coord, const PixelSampler &sampler, int nSamples) -> Vec3f
+        {
+            WalkPacket packet;
+            return packet.estimate(coord, nSamples, sampler, kernel, [&kernel](WalkPacket &packet) -> void
+            {
+                for (int k = 0; k < PACKET_WIDTH; k++)
+                {
+                    if (!packet.query[k]) continue;
+                    packet.R[k] = kernel.distance(Vec2f(packet.px[k], packet.py[k]), packet.b[k]);
+                }
+            });
+        });
+    }
+
+private:
+    float rrProb = 0.99;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pwos/common.h>
+
+/**
+ * Read-only contents of a file. The file is memory mapped where supported (pages are only read
+ * from disk when they are first touched), otherwise it is read into memory.
+ */
+class MappedFile
+{
+public:
+    /**
+     * Map a file.
+     *
+     * @param filename      name of the file
+     */
+    MappedFile(string filename);
+
+    ~MappedFile();
+
+    // the mapping is owned by a single object
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @return the contents of the file (nullptr if the file is empty)
+     */
+    const char* data() const
+    {
+        return bytes;
+    }
+
+    /**
+     * @return the size of the file in bytes
+     */
+    size_t size() const
+    {
+        return numBytes;
+    }
+
+private:
+    const char *bytes = nullptr;
+    size_t numBytes = 0;
+
+    // true if bytes points to a memory mapping, false if it points into buffer
+    bool mapped = false;
+    vector<char> buffer;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <pwos/common.h>
+
+/**
+ * Hardware events counted by PerfCounters.
+ */
+enum class PerfEvent
+{
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES
+};
+
+// number of PerfEvents
+constexpr int NUM_PERF_EVENTS = int(PerfEvent::BRANCH_MISSES) + 1;
+
+inline const char* getPerfEventName(PerfEvent event)
+{
+    switch (event)
+    {
+        case PerfEvent::CYCLES: return "cycles";
+        case PerfEvent::INSTRUCTIONS: return "instructions";
+        case PerfEvent::CACHE_MISSES: return "cache misses";
+        case PerfEvent::BRANCH_MISSES: return "branch misses";
+    }
+    return "unknown";
+}
+
+/**
+ * Hardware performance counters of the calling thread, read through a Linux perf_event_open counter group.
+ * Every thread opens its own group the first time it reads it. Events the machine (or the
+ * perf_event_paranoid setting) does not allow are left out, if none can be opened the counters are disabled.
+ */
+class PerfCounters
+{
+public:
+    inline static bool enabled = false;
+
+    // which events could be opened (checked by init on the calling thread)
+    inline static bool available[NUM_PERF_EVENTS] = {};
+
+    /**
+     * Enable the counters if the calling thread can open at least one of the events, warns otherwise.
+     */
+    static void init();
+
+    /**
+     * Read the counters of the calling thread.
+     *
+     * @param values    set to the current count of each event (0 for unavailable events)
+     *
+     * @return false if the calling thread's counters could not be opened
+     */
+    static bool read(uint64_t values[NUM_PERF_EVENTS]);
+};
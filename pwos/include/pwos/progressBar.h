@@ -2,76 +2,109 @@
 
 #include <pwos/common.h>
 
-class ProgressBar {
-public:
-  int barWidth = 70;
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-  int workCompleted = 0;
-  int totalWork = 0;
+/**
+ * Progress of a (parallel) loop. Workers only bump their own counter, a background reporter thread
+ * sums the counters a few times per second and redraws the bar with the walk/step throughput and the ETA.
+ * Nothing but the final time is printed when stdout is not a terminal (batch runs, redirected output).
+ */
+class ProgressBar
+{
+public:
+    int barWidth = 50;
 
-  std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+    // time between two redraws of the reporter
+    std::chrono::milliseconds interval = std::chrono::milliseconds(250);
 
-  ProgressBar() {}
+    ProgressBar() {}
 
-  ProgressBar(int barWidth): barWidth(barWidth) {}
+    ProgressBar(int barWidth): barWidth(barWidth) {}
 
-  void start() {
-    draw(0.0f);
-    startTime = Time::now();
-  }
+    ~ProgressBar();
 
-  void start(int _totalWork)
-  {
-    workCompleted = 0;
-    totalWork = _totalWork;
-    start();
-  }
+    ProgressBar(const ProgressBar&) = delete;
 
-  void set(float progress) {
-    draw(progress);
-  }
+    ProgressBar& operator=(const ProgressBar&) = delete;
 
-  ProgressBar operator++(int)
-  {
-    #pragma omp atomic
-    workCompleted++;
+    /**
+     * Reset the progress and start the reporter.
+     *
+     * @param totalWork         units of work until done
+     * @param walksPerUnit      random walks taken per unit of work, 0 if the work is not made of walks
+     */
+    void start(long totalWork, double walksPerUnit = 0);
 
-    #pragma omp critical
+    inline ProgressBar& operator++(int)
     {
-      set(float(workCompleted) / totalWork);
+        return *this += 1;
     }
-    return *this;
-  }
 
-  ProgressBar operator+=(int a)
-  {
-    #pragma omp atomic
-    workCompleted += a;
-
-    #pragma omp critical
+    /**
+     * Add completed work of the calling thread. Lock free: every thread owns a counter on its own cache line,
+     * which it updates with a relaxed store (only the reporter reads it).
+     */
+    inline ProgressBar& operator+=(long work)
     {
-      set(float(workCompleted) / totalWork);
+        size_t tid = omp_get_thread_num();
+        if (tid + 1 < counters.size())
+        {
+            long &count = counters[tid].count;
+            std::atomic_ref<long>(count).store(count + work, std::memory_order_relaxed);
+        }
+        else
+        {
+            // more threads than expected, these share the last counter
+            std::atomic_ref<long>(counters.back().count).fetch_add(work, std::memory_order_relaxed);
+        }
+        return *this;
     }
-    return (*this);
-  }
 
-  void finish() {
-    draw(1.0f);
-    std::cout << std::endl;
-    fsec duration = Time::now() - startTime;
-    std::cout << "Finished in " <<  duration.count() << " s" << std::endl;
-  }
+    /**
+     * Stop the reporter, draw the completed bar and print the elapsed time.
+     */
+    void finish();
 
 private:
-  void draw(float progress) {
-    std::cout << "[";
-    int pos = barWidth * progress;
-    for (int i = 0; i < barWidth; ++i) {
-        if (i < pos) std::cout << "=";
-        else if (i == pos) std::cout << ">";
-        else std::cout << " ";
-    }
-    std::cout << "] " << int(progress * 100.0) << " %\r";
-    std::cout << std::flush;
-  }
+    struct alignas(64) Counter
+    {
+        long count = 0;
+    };
+
+    // one counter per thread plus a shared one for threads beyond that
+    vector<Counter> counters;
+
+    long totalWork = 0;
+
+    double walksPerUnit = 0;
+
+    // walk steps counted by Stats at start, the throughput only counts the steps since then
+    long initSteps = 0;
+
+    Time::time_point startTime;
+
+    // false when stdout is not a terminal
+    bool drawing = false;
+
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopRequested = false;
+
+    /**
+     * @return the work completed by all threads so far
+     */
+    long getWorkCompleted();
+
+    /**
+     * Redraw every interval until stopReporter is called.
+     */
+    void report();
+
+    void stopReporter();
+
+    void draw(long workCompleted);
 };
@@ -37,6 +37,16 @@ struct RandomWalk
     // terminated the current random walk
     bool terminated;
 
+    // index of the current sample and its sampler (see getSampler)
+    int sample;
+    pcg32 sampler;
+
+    // distance to the boundary and boundary value at startP, computed by the first step of
+    // the first sample and reused by every restart of the walk
+    bool hasStartQuery;
+    float startR;
+    Vec3f startB;
+
     /**
      * Initialize a random walk.
      * 
@@ -48,9 +58,7 @@ struct RandomWalk
     RandomWalk(int parentId, int pixelId, Vec2f p, int nSamples);
 
     /**
-     * Reset the random walk.
-     * 
-     * @param p     position where to reset the walk
+     * Reset the random walk to start the next sample.
      */
     void initializeWalk();
 
@@ -253,4 +261,10 @@ public:
      */
     vector<shared_ptr<RandomWalk>> recvTerminatedWalks();
 
+private:
+    /**
+     * Move the send buffers into the other threads' queues.
+     */
+    void flushSendBuffers();
+
 };
@@ -2,6 +2,36 @@
 
 #include <pwos/common.h>
 
+// first bytes of a binary scene file
+constexpr char SCENE_FILE_MAGIC[8] = { 'P', 'W', 'O', 'S', 'S', 'C', 'N', '\0' };
+constexpr uint32_t SCENE_FILE_VERSION = 1;
+
+// alignment of the arrays in a binary scene file (relative to the start of the file)
+constexpr uint64_t SCENE_FILE_ALIGNMENT = 64;
+
+/**
+ * Header of a binary scene file (little endian). The header is followed by the circles as SoA arrays,
+ * each one starting at its offset: x and y coordinates of the centers and radii (float), the index of each
+ * circle's boundary value in the palette (uint32) and the palette itself (rgb floats).
+ */
+struct SceneFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numCircles;
+    uint32_t numColors;
+    uint32_t padding;
+
+    // scene window (bottom left x, bottom left y, top right x, top right y)
+    float window[4];
+
+    // byte offsets of the arrays from the start of the file
+    uint64_t xOffset, yOffset, radiusOffset, boundaryOffset, paletteOffset;
+
+    // size of the whole file in bytes
+    uint64_t fileSize;
+};
+
 /**
  * Contains a collection of circles with boundary values. 
  * 
@@ -11,7 +41,8 @@ class Scene
 {
 public:
     /**
-     * Construct a scene from a scene file. File is a list of circles with boundary data,
+     * Construct a scene from a scene file, either a binary scene file (see SceneFileHeader), which
+     * is memory mapped and used in place, or a CSV file. The CSV file is a list of circles with boundary data,
      * which must be formatted as follows:
      * 
      * blx, bly, trx, try                   // scene range (top left x, top left y, bottom right x, bottom right y)
@@ -26,6 +57,10 @@ public:
      */
     Scene(std::string filename);
 
+    // a scene is loaded once and shared (see Integrator), copies would duplicate its circles
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
     /**
      * Computes the closest point to o from all of the circles in the scene.
      * 
@@ -34,21 +69,33 @@ public:
      * 
      * @returns the closest point to "o"
      */
-    Vec2f getClosestPoint(Vec2f o, Vec3f &b, bool isSetup = false);
+    Vec2f getClosestPoint(Vec2f o, Vec3f &b, bool isSetup = false) const;
 
     /**
      * Returns the window of the scene window=(bottom left x, bottom left y, top right x, top right y)
      * 
      * @return window
      */
-    Vec4f getWindow();
+    Vec4f getWindow() const;
 
     /**
      * Returns the name of the scene.
      * 
      * @returns the name of the scene.
      */
-    string getName();
+    string getName() const;
+
+    /**
+     * @returns the number of circles in the scene.
+     */
+    int getNumCircles() const;
+
+    /**
+     * Write the scene as a binary scene file.
+     *
+     * @param filename      name of the file
+     */
+    void saveBinary(string filename) const;
 
 private:
     // scene name
@@ -57,7 +104,35 @@ private:
     // scene window (top left x, top left y, bottom right x, bottom right y)
     Vec4f window;
 
-    // list of circles
-    vector<shared_ptr<Circle>> circles;
+    // circles, as the arrays of the binary scene file (see SceneFileHeader)
+    int numCircles = 0;
+    const float *centerX = nullptr;
+    const float *centerY = nullptr;
+    const float *radius = nullptr;
+    const uint32_t *boundaryIndex = nullptr;
+    const float *palette = nullptr;
+
+    // the whole binary scene file
+    const char *bytes = nullptr;
+    size_t numBytes = 0;
 
+    // keeps the memory the arrays point into alive (the mapped binary file, or the file built from a CSV file)
+    shared_ptr<const void> storage;
+
+    /**
+     * Parse a CSV scene file into a binary scene file held in memory. The lines are parsed in parallel.
+     *
+     * @param file          contents of the file
+     * @param filename      name of the file (for error messages)
+     */
+    void loadCSV(const MappedFile &file, string filename);
+
+    /**
+     * Point the circle arrays into a binary scene file, after checking that it is valid.
+     *
+     * @param data          contents of the binary scene file
+     * @param size          size of data in bytes
+     * @param filename      name of the file (for error messages)
+     */
+    void setArrays(const char *data, size_t size, string filename);
 };
@@ -1,6 +1,85 @@
 #pragma once
 
 #include <pwos/common.h>
+#include <pwos/perfCounters.h>
+#include <pwos/trace.h>
+
+#include <atomic>
+
+// number of StatTimerTypes
+constexpr int NUM_STAT_TIMER_TYPES = int(StatTimerType::RENDER) + 1;
+
+// histogram of steps per walk: bin i counts walks with [2^i, 2^(i+1)) steps, the last bin also counts longer walks
+constexpr int NUM_STEP_BINS = 24;
+
+// histogram of step radii: bin i counts radii in [2^(i + MIN_RADIUS_EXP), 2^(i + 1 + MIN_RADIUS_EXP)),
+// the first and last bins also count smaller and larger radii
+constexpr int NUM_RADIUS_BINS = 32;
+constexpr int MIN_RADIUS_EXP = -8;
+
+// every REGION_SAMPLE_ROUNDS-th MCWoG round of a thread adds a sample to its region load timeline
+constexpr int REGION_SAMPLE_ROUNDS = 64;
+
+/**
+ * Load of a thread's MCWoG region at one point in time.
+ */
+struct RegionSample
+{
+    // cycle counter when the sample was taken
+    uint64_t cycles;
+
+    int round;
+
+    // active walks the thread received in that round
+    int activeWalks;
+};
+
+/**
+ * Timers and counters of one thread, padded to a cache line so that threads never share one.
+ */
+struct alignas(64) ThreadStats
+{
+    // cycles spent per timer type (see readCycleCounter)
+    uint64_t cycles[NUM_STAT_TIMER_TYPES] = {};
+
+    // number of timer calls per timer type, including the ones skipped by sampling
+    uint64_t calls[NUM_STAT_TIMER_TYPES] = {};
+
+    // hardware counter deltas per timer type (see PerfCounters)
+    uint64_t perf[NUM_STAT_TIMER_TYPES][NUM_PERF_EVENTS] = {};
+
+    // number of calls to INCREMENT_COUNT/ADD_COUNT
+    uint64_t counterCalls = 0;
+
+    long numClosestPointQueries = 0;
+
+    long numClosestPointQueriesSetup = 0;
+
+    long numGridQueries = 0;
+
+    long numWalkSteps = 0;
+
+    // exact queries forced by a grid bound below minGridR
+    long numGridFallbacks = 0;
+
+    long stepsPerWalk[NUM_STEP_BINS] = {};
+
+    long stepRadius[NUM_RADIUS_BINS] = {};
+
+    long terminations[NUM_WALK_TERMINATIONS] = {};
+
+    // walks that ended outside of the rendered window
+    long numEndedOutsideWindow = 0;
+
+    // MCWoG traffic: number of active/terminated walks this thread sent to each thread (including itself)
+    vector<long> activeWalksSentTo, terminatedWalksSentTo;
+
+    // MCWoG queue depth: rounds (that received active walks), sum and max of the active walks received per round
+    long numRounds = 0, queueDepthSum = 0, maxQueueDepth = 0;
+
+    // MCWoG region load timeline
+    vector<RegionSample> regionTimeline;
+};
 
 class Stats
 {
@@ -14,41 +93,292 @@ public:
     // the setup time
     inline static fsec setupTime;
 
-    // the total run time for each thread
-    inline static vector<fsec> threadTime;
+    // the time spent in the integrator's render call
+    inline static fsec renderTime;
+
+    inline static long numGridPoints;
+
+    // total number of random walks (samples) taken
+    inline static long numWalks;
+
+    // timers and counters of each thread
+    inline static vector<ThreadStats> threadStats;
+
+    // run configuration (integrator, spp, ...), written along with the stats
+    inline static vector<std::pair<string, string>> config;
+
+    // only 1 in timerSampleRate calls of the fine grained timers (closest point and grid queries)
+    // are timed, the measured time is scaled up accordingly
+    inline static int timerSampleRate = 1;
 
-    // How long each thread spends sending random walks
-    inline static vector<fsec> threadSendWalksTime;
+    /**
+     * Reset all stats (the run configuration is kept).
+     *
+     * @param nthreads          number of threads that record stats
+     * @param timerSampleRate   time 1 in timerSampleRate closest point/grid queries
+     */
+    static void init(int nthreads = 1, int timerSampleRate = 1);
 
-    // How long each thread spends receiving random walks
-    inline static vector<fsec> threadRecvWalksTime;
+    /**
+     * Times a block of work that is done by the calling thread for as long as it is in scope.
+     */
+    class ScopedTimer
+    {
+    public:
+        inline ScopedTimer(StatTimerType type)
+        {
+#if PWOS_STATS
+            size_t tid = omp_get_thread_num();
+            ASSERT_IF(threadStats.size() <= tid, "Must initialize thread timers. Thread " + to_string(tid) + " out of range.");
+            stats = &threadStats[tid];
+            t = int(type);
+            weight = isSampled(type) ? timerSampleRate : 1;
+            timed = stats->calls[t]++ % weight == 0;
+            if (!timed) return;
+            perf = PerfCounters::enabled && PerfCounters::read(perfStart);
+            start = readCycleCounter();
+#endif
+        }
 
-    // How long each thread spends reading from memory (ClosestPointGrid Queries)
-    inline static vector<fsec> threadCPGTime;
+        inline ~ScopedTimer()
+        {
+#if PWOS_STATS
+            if (!timed) return;
+            uint64_t end = readCycleCounter();
+            stats->cycles[t] += (end - start) * weight;
+            if (perf)
+            {
+                uint64_t perfEnd[NUM_PERF_EVENTS] = {};
+                PerfCounters::read(perfEnd);
+                for (int i = 0; i < NUM_PERF_EVENTS; i++) stats->perf[t][i] += (perfEnd[i] - perfStart[i]) * weight;
+            }
+            if (Trace::enabled && isTraced(StatTimerType(t))) Trace::record(getStatTimerName(StatTimerType(t)), start, end);
+#endif
+        }
 
-    // how long each thread spends doing a closest point query
-    inline static vector<fsec> threadCPQTime;
+        ScopedTimer(const ScopedTimer&) = delete;
 
-    // how long each thread spends doing a closest point queries during setup
-    inline static vector<fsec> threadCPQSetupTime;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
 
-    inline static int numGridPoints;
+    private:
+#if PWOS_STATS
+        ThreadStats *stats;
+        int t;
+        uint64_t weight;
+        bool timed;
+        uint64_t start = 0;
+        bool perf = false;
+        uint64_t perfStart[NUM_PERF_EVENTS] = {};
+#endif
+    };
 
-    inline static vector<int> numClosestPointQueries;
+    template <typename Block>
+    static void TIME_THREAD(StatTimerType type, Block f)
+    {
+        ScopedTimer timer(type);
+        f();
+    }
 
-    inline static vector<int> numClosestPointQueriesSetup;
+    template <typename Block>
+    static void TIME(StatTimerType type, Block f)
+    {
+        auto start = Time::now();
+        uint64_t startCycles = readCycleCounter();
+        f();
+        if (Trace::enabled) Trace::record(getStatTimerName(type), startCycles, readCycleCounter(), -1, true);
+        addTime(type, Time::now() - start);
+    }
 
-    inline static vector<int> numGridQueries;
+    static void SET_COUNT(StatType type, long val);
 
-    static void init(int nthreads = 1);
+    static inline void INCREMENT_COUNT(StatType type)
+    {
+        ADD_COUNT(type, 1);
+    }
 
-    static void TIME_THREAD(StatTimerType type, FunctionBlock f);
+    static inline void ADD_COUNT(StatType type, long val)
+    {
+#if PWOS_STATS
+        ThreadStats &s = threadStats[omp_get_thread_num()];
+        s.counterCalls++;
+        switch(type)
+        {
+            case StatType::CLOSEST_POINT_QUERY:
+                s.numClosestPointQueries += val;
+                break;
+            case StatType::SETUP_CLOSEST_POINT_QUERY:
+                s.numClosestPointQueriesSetup += val;
+                break;
+            case StatType::GRID_QUERY:
+                s.numGridQueries += val;
+                break;
+            case StatType::WALK_STEPS:
+                // relaxed store, the progress reporter reads the steps while the walks run
+                std::atomic_ref<long>(s.numWalkSteps).store(s.numWalkSteps + val, std::memory_order_relaxed);
+                break;
+            case StatType::GRID_FALLBACK:
+                s.numGridFallbacks += val;
+                break;
+            default:
+                break;
+        }
+#endif
+    }
 
-    static void TIME(StatTimerType type, FunctionBlock f);
+    /**
+     * Record walks sent by the calling thread (MCWoG).
+     *
+     * @param receiver          thread the walks are sent to
+     * @param nActive           number of active walks
+     * @param nTerminated       number of terminated walks
+     */
+    static inline void RECORD_TRAFFIC(int receiver, long nActive, long nTerminated)
+    {
+#if PWOS_STATS
+        ThreadStats &s = threadStats[omp_get_thread_num()];
+        s.activeWalksSentTo[receiver] += nActive;
+        s.terminatedWalksSentTo[receiver] += nTerminated;
+#endif
+    }
 
-    static void SET_COUNT(StatType type, int val);
+    /**
+     * Record the number of active walks the calling thread received at the start of an MCWoG round.
+     */
+    static inline void RECORD_ROUND(int activeWalks)
+    {
+#if PWOS_STATS
+        ThreadStats &s = threadStats[omp_get_thread_num()];
+        if (s.numRounds % REGION_SAMPLE_ROUNDS == 0) s.regionTimeline.push_back(RegionSample{readCycleCounter(), int(s.numRounds), activeWalks});
+        s.numRounds++;
+        s.queueDepthSum += activeWalks;
+        s.maxQueueDepth = std::max(s.maxQueueDepth, long(activeWalks));
+#endif
+    }
 
-    static void INCREMENT_COUNT(StatType type);
+    /**
+     * Add the radius of a step to the calling thread's histogram.
+     */
+    static inline void RECORD_STEP(float R)
+    {
+#if PWOS_STATS
+        int bin = std::clamp(std::ilogb(R) - MIN_RADIUS_EXP, 0, NUM_RADIUS_BINS - 1);
+        threadStats[omp_get_thread_num()].stepRadius[bin]++;
+#endif
+    }
+
+    /**
+     * Add a finished walk to the calling thread's histograms.
+     *
+     * @param termination       how the walk ended
+     * @param nSteps            number of distance queries the walk took
+     * @param outsideWindow     true if the walk ended outside of the rendered window
+     */
+    static inline void RECORD_WALK(WalkTermination termination, int nSteps, bool outsideWindow)
+    {
+#if PWOS_STATS
+        ThreadStats &s = threadStats[omp_get_thread_num()];
+        int bin = nSteps > 0 ? std::min(std::ilogb(float(nSteps)), NUM_STEP_BINS - 1) : 0;
+        s.stepsPerWalk[bin]++;
+        s.terminations[int(termination)]++;
+        s.numEndedOutsideWindow += outsideWindow;
+#endif
+    }
+
+    /**
+     * @return the walk steps of all threads so far, safe to call while the threads are walking
+     */
+    static long getNumWalkSteps();
+
+    /**
+     * @return the time (in seconds) that thread tid spent in timers of the given type
+     */
+    static float getThreadTime(int tid, StatTimerType type);
+
+    /**
+     * Record a setting of the run, in the order it should be written.
+     */
+    static void SET_CONFIG(string key, string value);
 
     static void report();
+
+    /**
+     * Write the run configuration, all counters and timers (totals and per thread) and the
+     * derived throughput metrics as JSON.
+     *
+     * @param filename
+     */
+    static void writeJSON(string filename);
+
+    /**
+     * Write the same data as writeJSON as CSV, one value per row (section, thread, metric, value).
+     *
+     * @param filename
+     */
+    static void writeCSV(string filename);
+
+private:
+    typedef vector<std::pair<string, double>> Metrics;
+    // cycle counter and clock at init, used to convert cycles to seconds
+    inline static uint64_t initCycles;
+    inline static Time::time_point initTime;
+
+    // measured cost of one timer call and one counter call (in cycles)
+    inline static double timerCallCycles, counterCallCycles;
+
+    /**
+     * @return true if the timer type is timed only 1 in timerSampleRate calls
+     */
+    static inline bool isSampled(StatTimerType type)
+    {
+        return type == StatTimerType::CLOSEST_POINT_GRID
+            || type == StatTimerType::CLOSEST_POINT_QUERY
+            || type == StatTimerType::SETUP_CLOSEST_POINT_QUERY;
+    }
+
+    /**
+     * @return true if the timer type shows up in the trace (grid queries are too short and frequent to be worth it,
+     * grid creation is traced per block)
+     */
+    static inline bool isTraced(StatTimerType type)
+    {
+        return type != StatTimerType::CLOSEST_POINT_GRID && type != StatTimerType::GRID_CREATION;
+    }
+
+    /**
+     * Measure the cost of the timers and counters so that report can estimate the instrumentation overhead.
+     */
+    static void calibrate();
+
+    /**
+     * @return the number of cycle counter ticks per second
+     */
+    static double getCyclesPerSecond();
+
+    static void addTime(StatTimerType type, fsec duration);
+
+    /**
+     * @return run level times and counters, and throughput over the render time
+     */
+    static Metrics getTotals();
+
+    /**
+     * @return the times and counters of one thread
+     */
+    static Metrics getThreadMetrics(int tid);
+
+    /**
+     * @return true if any thread recorded MCWoG rounds
+     */
+    static bool hasRounds();
+
+    /**
+     * @return true if any thread recorded a walk in the histograms (integrators without walks, or whose
+     *         walk kernel has no WalkStatistics, leave them empty)
+     */
+    static bool hasWalkHistograms();
+
+    /**
+     * @return the walk histograms merged over all threads, one entry per bin (e.g. "steps_per_walk[4,8)")
+     */
+    static Metrics getHistograms();
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <pwos/common.h>
+
+// tiles are shrunk until every thread gets at least this many of them
+constexpr int MIN_TILES_PER_THREAD = 4;
+
+/**
+ * Distributes image tiles to threads through per-thread work-stealing deques.
+ *
+ * Tiles are ordered along a morton curve and each thread's deque initially holds a contiguous
+ * range of that order. Threads pop from the front of their own deque and, once it is empty,
+ * steal from the back of the other threads' deques.
+ *
+ * Small images would only give a few threads a tile, so the tile size is halved (down to single pixels)
+ * until there are at least MIN_TILES_PER_THREAD tiles per thread.
+ */
+class TileScheduler
+{
+public:
+    /**
+     * Build the tiles for an image and deal them to the threads.
+     * 
+     * @param res           resolution of the image
+     * @param tileSize      largest width and height (in pixels) of a tile
+     * @param nthreads      number of threads that will request tiles
+     */
+    TileScheduler(Vec2i res, int tileSize, int nthreads);
+
+    /**
+     * Get the next tile for a thread.
+     * 
+     * @param tid       id of the calling thread
+     * @param tile      set to the tile's pixel range (min x, min y, max x, max y), max is exclusive
+     * 
+     * @return false once there are no tiles left
+     */
+    bool next(int tid, Vec4i &tile);
+
+    /**
+     * @return the number of tiles
+     */
+    int getNumTiles();
+
+private:
+    // pixel ranges of the tiles, in morton order
+    vector<Vec4i> tiles;
+
+    // ids of the tiles each thread still has to render (or that can be stolen from it)
+    vector<deque<int>> queues;
+
+    // one lock per deque
+    vector<shared_ptr<mutex>> locks;
+};
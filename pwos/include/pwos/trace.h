@@ -0,0 +1,127 @@
+#pragma once
+
+#include <pwos/common.h>
+
+/**
+ * A complete (begin + end) event on a thread's timeline.
+ */
+struct TraceEvent
+{
+    // static string naming the event
+    const char *name;
+
+    // optional id shown in the event's args (e.g. the block of the grid being built), -1 for none
+    int id;
+
+    // cycle counter at begin and end (see readCycleCounter)
+    uint64_t start, end;
+};
+
+/**
+ * The events of one thread. Only the owning thread writes to it, so no locking is needed.
+ */
+struct alignas(64) TraceBuffer
+{
+    // ring buffer of frequent events, once full the oldest events are overwritten
+    vector<TraceEvent> events;
+
+    // total number of events recorded, events[numRecorded % events.size()] is written next
+    uint64_t numRecorded = 0;
+
+    // rare events (setup, grid construction, ...) that are always kept
+    vector<TraceEvent> phases;
+};
+
+/**
+ * Timeline tracing of the per-thread phases, written as Chrome trace JSON (chrome://tracing or Perfetto).
+ * Disabled unless init is called, compiled out with PWOS_STATS=0.
+ */
+class Trace
+{
+public:
+    inline static bool enabled = false;
+
+    /**
+     * Enable tracing.
+     *
+     * @param nthreads      number of threads that record events
+     * @param capacity      max number of frequent events kept per thread
+     */
+    static void init(int nthreads, int capacity = 1 << 18);
+
+    /**
+     * Record an event of the calling thread.
+     *
+     * @param name      static string naming the event
+     * @param start     cycle counter at begin
+     * @param end       cycle counter at end
+     * @param id        optional id, -1 for none
+     * @param phase     true for rare events that must not be overwritten
+     */
+    static inline void record(const char *name, uint64_t start, uint64_t end, int id = -1, bool phase = false)
+    {
+#if PWOS_STATS
+        size_t tid = omp_get_thread_num();
+        if (tid >= buffers.size()) return;
+        TraceBuffer &buffer = buffers[tid];
+        if (phase)
+        {
+            buffer.phases.push_back(TraceEvent{name, id, start, end});
+            return;
+        }
+        buffer.events[buffer.numRecorded % buffer.events.size()] = TraceEvent{name, id, start, end};
+        buffer.numRecorded++;
+#endif
+    }
+
+    /**
+     * Records an event of the calling thread that lasts as long as the scope is alive.
+     */
+    class Scope
+    {
+    public:
+        inline Scope(const char *name, int id = -1, bool phase = false)
+        {
+#if PWOS_STATS
+            if (!enabled) return;
+            this->name = name;
+            this->id = id;
+            this->phase = phase;
+            start = readCycleCounter();
+#endif
+        }
+
+        inline ~Scope()
+        {
+#if PWOS_STATS
+            if (enabled) record(name, start, readCycleCounter(), id, phase);
+#endif
+        }
+
+        Scope(const Scope&) = delete;
+
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+#if PWOS_STATS
+        const char *name = nullptr;
+        int id = -1;
+        bool phase = false;
+        uint64_t start = 0;
+#endif
+    };
+
+    /**
+     * Write all recorded events as Chrome trace JSON.
+     *
+     * @param filename
+     */
+    static void write(string filename);
+
+private:
+    inline static vector<TraceBuffer> buffers;
+
+    // cycle counter and clock at init, events are written relative to them
+    inline static uint64_t initCycles;
+    inline static Time::time_point initTime;
+};
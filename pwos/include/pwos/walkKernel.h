@@ -0,0 +1,277 @@
+#pragma once
+
+#include <pwos/common.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/distanceQuery.h>
+#include <pwos/image.h>
+#include <pwos/randomWalk.h>
+#include <pwos/stats.h>
+
+/**
+ * Outcome of a single step of a random walk.
+ */
+enum class StepResult
+{
+    // within epsilon of the boundary, the walk takes the boundary value
+    HIT_BOUNDARY,
+
+    // terminated by russian roulette, the walk takes the value 0
+    RUSSIAN_ROULETTE,
+
+    // the walk moved to a new point
+    CONTINUE
+};
+
+/**
+ * Instrumentation policies, called by the walk kernel every time it queries the distance at p (onQuery),
+ * takes a step of radius R (onStep) and when a walk that took nSteps queries ends at p (onWalkEnd).
+ */
+
+/**
+ * No instrumentation.
+ */
+struct NoInstrumentation
+{
+    inline void onQuery(Vec2f) const {}
+
+    inline void onStep(float) const {}
+
+    inline void onWalkEnd(Vec2f, StepResult, int) const {}
+};
+
+/**
+ * Counts every distance query of a walk as one step (Stats WALK_STEPS) and records the
+ * walk histograms (steps per walk, step radius, termination).
+ */
+struct WalkStatistics
+{
+    Vec4f window;
+
+    inline void onQuery(Vec2f) const
+    {
+        Stats::INCREMENT_COUNT(StatType::WALK_STEPS);
+    }
+
+    inline void onStep(float R) const
+    {
+        Stats::RECORD_STEP(R);
+    }
+
+    inline void onWalkEnd(Vec2f p, StepResult result, int nSteps) const
+    {
+        bool outsideWindow = p.x() < window[0] || p.x() > window[2] || p.y() < window[1] || p.y() > window[3];
+        Stats::RECORD_WALK(result == StepResult::HIT_BOUNDARY ? WalkTermination::BOUNDARY_HIT : WalkTermination::RUSSIAN_ROULETTE, nSteps, outsideWindow);
+    }
+};
+
+/**
+ * Marks the grid points touched by thread 0 in a heat map.
+ */
+struct GridHeatMap
+{
+    Image *heatMap;
+    const ClosestPointGrid *cpg;
+    Vec4f window;
+
+    inline void onQuery(Vec2f p) const
+    {
+        if (omp_get_thread_num() != 0 || !cpg->pointInGridRange(p)) return;
+        Vec2i g = cpg->getGridCoordinates(p);
+        Vec2f gp = cpg->getGridPointCoordinates(g);
+        Vec2i pxy = getPixelCoords(gp, window, heatMap->getRes());
+        (*heatMap)(pxy.x(), pxy.y()) = Vec3f(1.0f, 1.0f, 1.0f);
+    }
+
+    inline void onStep(float) const {}
+
+    inline void onWalkEnd(Vec2f, StepResult, int) const {}
+};
+
+/**
+ * The walk on spheres step shared by every integrator, specialized at compile time on
+ * the distance query (see distanceQuery.h) and on an instrumentation policy.
+ */
+template <typename DistanceQuery, typename Instrumentation = NoInstrumentation>
+struct WalkKernel
+{
+    DistanceQuery distance;
+    Instrumentation instrumentation;
+    float rrProb;
+
+    /**
+     * Distance from p to the boundary.
+     *
+     * @param p
+     * @param b     boundary value at the closest point (valid whenever the distance is below BOUNDARY_EPSILON)
+     */
+    inline float query(Vec2f p, Vec3f &b) const
+    {
+        instrumentation.onQuery(p);
+        return distance(p, b);
+    }
+
+    /**
+     * The distance query split in two, for integrators that batch the exact fallbacks (see Wavefront).
+     * Only available with distance policies that provide bound and exact (see ConservativeGridDistance).
+     *
+     * @param p
+     * @param R     distance to the boundary (only set if no exact query is needed)
+     *
+     * @return false if p needs an exactQuery
+     */
+    inline bool boundQuery(Vec2f p, float &R) const
+    {
+        instrumentation.onQuery(p);
+        return distance.bound(p, R);
+    }
+
+    /**
+     * Exact fallback of a boundQuery that returned false.
+     *
+     * @param p
+     * @param b     boundary value at the closest point
+     */
+    inline float exactQuery(Vec2f p, Vec3f &b) const
+    {
+        return distance.exact(p, b);
+    }
+
+    /**
+     * Take one step from a point that is R away from the boundary.
+     *
+     * @param R         distance to the boundary
+     * @param sampler
+     * @param stepVec   offset to the next point (only set if the walk continues)
+     * @param fUpdate   factor to multiply the walk's throughput with (only set if the walk continues)
+     *
+     * @return how the step ended
+     */
+    inline StepResult step(float R, pcg32 &sampler, Vec2f &stepVec, float &fUpdate) const
+    {
+        if (R < BOUNDARY_EPSILON) return StepResult::HIT_BOUNDARY;
+        if (sampler.nextFloat() < (1.0f - rrProb)) return StepResult::RUSSIAN_ROULETTE;
+        fUpdate = 1.0f / rrProb;
+        stepVec = sampleCirclePoint(R, sampler.nextFloat());
+        instrumentation.onStep(R);
+        return StepResult::CONTINUE;
+    }
+
+    /**
+     * Run a complete walk.
+     *
+     * @param x0        starting point
+     * @param R0        distance from x0 to the boundary
+     * @param b0        boundary value at the closest point to x0
+     * @param sampler
+     *
+     * @return the walk's estimate of the solution at x0
+     */
+    inline Vec3f walk(Vec2f x0, float R0, Vec3f b0, pcg32 &sampler) const
+    {
+        Vec2f p = x0;
+        Vec3f b = b0;
+        float R = R0;
+        float f = 1.0f;
+        Vec2f stepVec(0.0f, 0.0f);
+        float fUpdate = 1.0f;
+        for (int nSteps = 1; true; nSteps++)
+        {
+            StepResult result = step(R, sampler, stepVec, fUpdate);
+            switch (result)
+            {
+                case StepResult::HIT_BOUNDARY:
+                    instrumentation.onWalkEnd(p, result, nSteps);
+                    return f * b;
+                case StepResult::RUSSIAN_ROULETTE:
+                    instrumentation.onWalkEnd(p, result, nSteps);
+                    return Vec3f(0.0f, 0.0f, 0.0f);
+                case StepResult::CONTINUE:
+                    f *= fUpdate;
+                    p += stepVec;
+                    R = query(p, b);
+                    break;
+            }
+        }
+    }
+
+    /**
+     * Advance a random walk that is handed between threads (see RandomWalkManager) by a single step.
+     * The first distance query of a walk is cached in it and reused whenever the walk is restarted.
+     * Random numbers are drawn from the walk's own sampler, so the result does not depend on which thread advances it.
+     *
+     * @param rw        random walk
+     */
+    inline void advance(RandomWalk &rw) const
+    {
+        Vec3f b;
+        float R;
+        if (rw.currSteps == 0 && rw.hasStartQuery)
+        {
+            R = rw.startR;
+            b = rw.startB;
+        }
+        else
+        {
+            R = query(rw.p, b);
+            if (rw.currSteps == 0)
+            {
+                rw.hasStartQuery = true;
+                rw.startR = R;
+                rw.startB = b;
+            }
+        }
+
+        Vec2f stepVec(0.0f, 0.0f);
+        float fUpdate = 1.0f;
+        StepResult result = step(R, rw.sampler, stepVec, fUpdate);
+        switch (result)
+        {
+            case StepResult::HIT_BOUNDARY:
+                instrumentation.onWalkEnd(rw.p, result, rw.currSteps + 1);
+                rw.terminate(b);
+                break;
+            case StepResult::RUSSIAN_ROULETTE:
+                instrumentation.onWalkEnd(rw.p, result, rw.currSteps + 1);
+                rw.terminate(Vec3f(0.0f, 0.0f, 0.0f));
+                break;
+            case StepResult::CONTINUE:
+                rw.takeStep(stepVec, fUpdate);
+                break;
+        }
+    }
+
+    /**
+     * Sum of n walks started at x0. The first distance query is the same for every walk, so it is done once.
+     *
+     * @param x0
+     * @param n         number of walks
+     * @param sampler   samplers of the walks, walk j uses sampler.get(j)
+     */
+    inline Vec3f estimate(Vec2f x0, int n, const PixelSampler &sampler) const
+    {
+        Vec3f b0;
+        float R0 = query(x0, b0);
+        if (R0 < BOUNDARY_EPSILON)
+        {
+            for (int j = 0; j < n; j++) instrumentation.onWalkEnd(x0, StepResult::HIT_BOUNDARY, 1);
+            return b0 * float(n);
+        }
+
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (int j = 0; j < n; j++)
+        {
+            pcg32 walkSampler = sampler.get(j);
+            sum += walk(x0, R0, b0, walkSampler);
+        }
+        return sum;
+    }
+};
+
+/**
+ * Build a walk kernel, deducing the policy types.
+ */
+template <typename DistanceQuery, typename Instrumentation = NoInstrumentation>
+inline WalkKernel<DistanceQuery, Instrumentation> makeWalkKernel(DistanceQuery distance, float rrProb, Instrumentation instrumentation = Instrumentation())
+{
+    return WalkKernel<DistanceQuery, Instrumentation>{distance, instrumentation, rrProb};
+}
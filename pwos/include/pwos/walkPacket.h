@@ -0,0 +1,250 @@
+#pragma once
+
+#include <pwos/common.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/stats.h>
+#include <pwos/walkKernel.h>
+#include <cstring>
+
+// number of walks advanced in lockstep (one per lane of the widest vector unit available)
+#if defined(__AVX512F__)
+#define PACKET_WIDTH 16
+#else
+#define PACKET_WIDTH 8
+#endif
+
+/**
+ * One pcg32 generator per lane of a packet. Each lane produces exactly the sequence
+ * of a pcg32 seeded with the same state/stream, but all lanes are advanced at once.
+ */
+struct PacketSampler
+{
+    alignas(64) uint64_t state[PACKET_WIDTH];
+    alignas(64) uint64_t inc[PACKET_WIDTH];
+
+    /**
+     * Continue the sequence of a scalar sampler in one lane.
+     *
+     * @param k         lane
+     * @param sampler   scalar sampler whose state is copied into the lane
+     */
+    inline void seedLane(int k, const pcg32 &sampler)
+    {
+        state[k] = sampler.state;
+        inc[k] = sampler.inc;
+    }
+
+    /**
+     * Draw one uniform float in [0, 1) for every lane.
+     *
+     * @param out       PACKET_WIDTH floats
+     */
+    inline void nextFloat(float *out)
+    {
+        #pragma omp simd
+        for (int k = 0; k < PACKET_WIDTH; k++)
+        {
+            uint64_t oldstate = state[k];
+            state[k] = oldstate * PCG32_MULT + inc[k];
+            uint32_t xorshifted = uint32_t(((oldstate >> 18u) ^ oldstate) >> 27u);
+            uint32_t rot = uint32_t(oldstate >> 59u);
+            uint32_t r = (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+            uint32_t bits = (r >> 9) | 0x3f800000u;
+            float f;
+            std::memcpy(&f, &bits, sizeof(float));
+            out[k] = f - 1.0f;
+        }
+    }
+};
+
+/**
+ * A packet of PACKET_WIDTH independent random walks that all start at the same point
+ * (i.e. samples of the same pixel). Walks are advanced in lockstep, lanes whose walk terminated
+ * are restarted while samples remain, otherwise they are masked off.
+ *
+ * The first distance query of every walk is done once through the scalar walk kernel, like in WalkKernel::estimate.
+ * The remaining queries are done by a distance stage over the whole packet and steps are taken for all lanes at
+ * once, so that they vectorize. Steps use the same fastSinCos and random numbers as WalkKernel::step and the walks'
+ * values are summed in sample order, so the estimate and the statistics are identical to WalkKernel::estimate with
+ * the same distance query. Queries, steps and walk ends are reported to the kernel's instrumentation like the kernel itself does.
+ */
+struct WalkPacket
+{
+    // positions of the walks
+    alignas(64) float px[PACKET_WIDTH];
+    alignas(64) float py[PACKET_WIDTH];
+
+    // radius of the next step (distance to boundary, or a conservative bound of it)
+    alignas(64) float R[PACKET_WIDTH];
+
+    // throughput of the walks
+    alignas(64) float f[PACKET_WIDTH];
+
+    // number of steps taken by the walks so far, counting the one in progress
+    alignas(64) int nSteps[PACKET_WIDTH];
+
+    // index of the sample each lane is walking
+    alignas(64) int sample[PACKET_WIDTH];
+
+    // 1 if the lane has a walk in flight
+    alignas(64) int active[PACKET_WIDTH];
+
+    // 1 if the lane needs a distance query (active and not at the start of its walk, whose R and b are shared)
+    alignas(64) int query[PACKET_WIDTH];
+
+    // 1 if the lane needs an exact closest point query (set by the distance stage)
+    alignas(64) int exact[PACKET_WIDTH];
+
+    // scratch space for the random numbers of a step
+    alignas(64) float u[PACKET_WIDTH];
+    alignas(64) float theta[PACKET_WIDTH];
+
+    // boundary value at the closest point (only valid after an exact query)
+    Vec3f b[PACKET_WIDTH];
+
+    PacketSampler sampler;
+
+    // value of every walk of the pixel, summed in sample order once all walks are done
+    vector<Vec3f> values;
+
+    /**
+     * Estimate the sum of spp walks started at x0. Every walk runs on its own sampler, a lane is
+     * seeded with it whenever it launches a walk.
+     *
+     * @param x0            starting point of the walks
+     * @param spp           number of walks to take
+     * @param pixelSampler  samplers of the walks, walk j uses pixelSampler.get(j)
+     * @param kernel        walk kernel, does the first query and provides the russian roulette probability and instrumentation
+     * @param distance      distance stage, fills R (and b for lanes that needed an exact query) of all lanes flagged in query
+     *
+     * @return the sum of all walks' values
+     */
+    template <typename Kernel, typename DistanceStage>
+    inline Vec3f estimate(Vec2f x0, int spp, const PixelSampler &pixelSampler, const Kernel &kernel, DistanceStage distance)
+    {
+        float rrProb = kernel.rrProb;
+        Vec3f b0;
+        float R0 = kernel.query(x0, b0);
+        if (R0 < BOUNDARY_EPSILON)
+        {
+            for (int j = 0; j < spp; j++) kernel.instrumentation.onWalkEnd(x0, StepResult::HIT_BOUNDARY, 1);
+            return b0 * float(spp);
+        }
+
+        values.assign(spp, Vec3f(0.0f, 0.0f, 0.0f));
+        int launched = 0;
+        int nActive = 0;
+        for (int k = 0; k < PACKET_WIDTH; k++)
+        {
+            active[k] = launched < spp;
+            if (active[k]) sampler.seedLane(k, pixelSampler.get(launched));
+            sample[k] = launched;
+            query[k] = 0;
+            px[k] = x0.x();
+            py[k] = x0.y();
+            R[k] = R0;
+            f[k] = 1.0f;
+            nSteps[k] = 1;
+            launched += active[k];
+            nActive += active[k];
+        }
+
+        while (nActive > 0)
+        {
+            for (int k = 0; k < PACKET_WIDTH; k++)
+            {
+                if (query[k]) kernel.instrumentation.onQuery(Vec2f(px[k], py[k]));
+            }
+            distance(*this);
+
+            sampler.nextFloat(u);
+            sampler.nextFloat(theta);
+
+            // step every lane that neither hit the boundary nor was killed by russian roulette
+            #pragma omp simd
+            for (int k = 0; k < PACKET_WIDTH; k++)
+            {
+                float s, c;
+                fastSinCos(theta[k] * float(2.0 * M_PI), s, c);
+                int move = active[k] && R[k] >= BOUNDARY_EPSILON && u[k] >= (1.0f - rrProb);
+                px[k] += move ? R[k] * c : 0.0f;
+                py[k] += move ? R[k] * s : 0.0f;
+                f[k] *= move ? 1.0f / rrProb : 1.0f;
+                query[k] = move;
+            }
+
+            // accumulate terminated lanes and restart them while there are samples left
+            for (int k = 0; k < PACKET_WIDTH; k++)
+            {
+                if (!active[k]) continue;
+                bool hit = R[k] < BOUNDARY_EPSILON;
+                if (!hit && u[k] >= (1.0f - rrProb))
+                {
+                    kernel.instrumentation.onStep(R[k]);
+                    nSteps[k]++;
+                    continue;
+                }
+
+                kernel.instrumentation.onWalkEnd(Vec2f(px[k], py[k]), hit ? StepResult::HIT_BOUNDARY : StepResult::RUSSIAN_ROULETTE, nSteps[k]);
+                if (hit) values[sample[k]] = f[k] * b[k];
+                if (launched < spp)
+                {
+                    sampler.seedLane(k, pixelSampler.get(launched));
+                    sample[k] = launched;
+                    px[k] = x0.x();
+                    py[k] = x0.y();
+                    R[k] = R0;
+                    f[k] = 1.0f;
+                    nSteps[k] = 1;
+                    launched++;
+                }
+                else
+                {
+                    active[k] = 0;
+                    nActive--;
+                }
+            }
+        }
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (Vec3f value : values) sum += value;
+        return sum;
+    }
+
+    /**
+     * Vectorized grid lookup for all lanes flagged in query. Lanes outside of the grid, or too
+     * close to the boundary for the grid bound to be useful, are flagged as needing an exact query.
+     *
+     * @param cpg           closest point grid
+     * @param minGridR      smallest usable grid radius
+     * @param nFallbacks    set to the number of lookups whose bound was below minGridR
+     *
+     * @return the number of grid lookups performed
+     */
+    inline int gridLookup(const ClosestPointGrid &cpg, float minGridR, int &nFallbacks)
+    {
+        const GridData *grid = cpg.grid;
+        int nLookups = 0;
+        int fallbacks = 0;
+
+        #pragma omp simd reduction(+: nLookups, fallbacks)
+        for (int k = 0; k < PACKET_WIDTH; k++)
+        {
+            int inRange = px[k] >= cpg.bl.x() && px[k] < cpg.tr.x() && py[k] >= cpg.bl.y() && py[k] < cpg.tr.y();
+            int gx = inRange ? int(floorf((px[k] - cpg.bl.x()) / cpg.cellLength)) : 0;
+            int gy = inRange ? int(floorf((py[k] - cpg.bl.y()) / cpg.cellLength)) : 0;
+            int bx = gx / cpg.blockWidth;
+            int by = gy / cpg.blockHeight;
+            int id = (gx - bx * cpg.blockWidth) + (gy - by * cpg.blockHeight) * cpg.blockWidth + (bx + by * cpg.nBlockCols) * cpg.blockSize;
+
+            float dx = px[k] - (cpg.cellLength * float(gx) + cpg.bl.x());
+            float dy = py[k] - (cpg.cellLength * float(gy) + cpg.bl.y());
+            float gridR = grid[id].dist - sqrtf(dx * dx + dy * dy);
+            R[k] = query[k] ? gridR : R[k];
+            exact[k] = query[k] && (!inRange || gridR < minGridR);
+            nLookups += query[k] && inRange;
+            fallbacks += query[k] && inRange && gridR < minGridR;
+        }
+        nFallbacks = fallbacks;
+        return nLookups;
+    }
+};
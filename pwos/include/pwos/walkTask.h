@@ -0,0 +1,110 @@
+#pragma once
+
+#include <pwos/common.h>
+#include <coroutine>
+#include <exception>
+
+/**
+ * A resumable estimate of a pixel (or any other Vec3f valued computation). The coroutine
+ * starts suspended and runs until its next co_await each time it is resumed.
+ */
+class WalkTask
+{
+public:
+    struct promise_type
+    {
+        Vec3f value = Vec3f(0.0f, 0.0f, 0.0f);
+        std::exception_ptr exception;
+
+        WalkTask get_return_object()
+        {
+            return WalkTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        void return_value(Vec3f v) { value = v; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    WalkTask() {};
+
+    WalkTask(WalkTask &&other) noexcept : handle(other.handle)
+    {
+        other.handle = nullptr;
+    }
+
+    WalkTask& operator=(WalkTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
+    WalkTask(const WalkTask&) = delete;
+
+    WalkTask& operator=(const WalkTask&) = delete;
+
+    ~WalkTask()
+    {
+        if (handle) handle.destroy();
+    }
+
+    /**
+     * @return true if the task holds a coroutine (finished or not)
+     */
+    bool valid() const
+    {
+        return bool(handle);
+    }
+
+    /**
+     * @return true if the coroutine ran to completion
+     */
+    bool done() const
+    {
+        return handle.done();
+    }
+
+    /**
+     * Run the coroutine until it suspends again, rethrows anything it threw.
+     */
+    void resume()
+    {
+        handle.resume();
+        if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+    }
+
+    /**
+     * @return the value passed to co_return
+     */
+    Vec3f result() const
+    {
+        return handle.promise().value;
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit WalkTask(std::coroutine_handle<promise_type> handle): handle(handle) {};
+};
+
+/**
+ * Awaitable that always suspends, used right after issuing a prefetch so that
+ * the scheduler can run other walks while the memory request is in flight.
+ */
+struct YieldToScheduler
+{
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+    void await_resume() const noexcept {}
+};
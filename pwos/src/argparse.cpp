@@ -117,6 +117,34 @@ string ArgParse::getStr(string id, string defaultValue)
     return flags[id].isSet ? flags[id].values[0] : defaultValue;
 }
 
+vector<string> ArgParse::getStrList(string id, string defaultValue)
+{
+    string list = getStr(id, defaultValue);
+    vector<string> values;
+    stringstream ss(list);
+    string cell;
+    while (getline(ss, cell, ','))
+    {
+        if (!cell.empty()) values.push_back(cell);
+    }
+    THROW_IF(values.empty(), "Flag with id " + id + " has no values.");
+    return values;
+}
+
+vector<int> ArgParse::getIntList(string id, string defaultValue)
+{
+    vector<int> values;
+    for (string value : getStrList(id, defaultValue)) values.push_back(std::stoi(value));
+    return values;
+}
+
+vector<float> ArgParse::getFloatList(string id, string defaultValue)
+{
+    vector<float> values;
+    for (string value : getStrList(id, defaultValue)) values.push_back(std::stof(value));
+    return values;
+}
+
 Vec2i ArgParse::getVec2i(string id, Vec2i defaultValue)
 {
     THROW_IF(flags.count(id) == 0, "Flag with id " + id + " is not registered with argparse instance.");
@@ -139,6 +167,11 @@ Vec4f ArgParse::getVec4f(string id, Vec4f defaultValue)
     return v;
 }
 
+int ArgParse::getNumMain()
+{
+    return main.size();
+}
+
 string ArgParse::getMain(int i, string errMsg)
 {
     if (errMsg.empty())
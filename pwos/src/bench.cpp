@@ -0,0 +1,303 @@
+#include <pwos/common.h>
+
+#include <pwos/argparse.h>
+#include <pwos/closestPointGrid.h>
+#include <pwos/image.h>
+#include <pwos/randomWalk.h>
+#include <pwos/scene.h>
+#include <pwos/stats.h>
+
+#include <iomanip>
+#include <numeric>
+
+/**
+ * Timings of one benchmark, one entry per repetition.
+ */
+struct BenchResult
+{
+    string name;
+
+    // operations done by one repetition
+    long opsPerRep;
+
+    // nanoseconds per operation of each repetition
+    vector<double> nsPerOp;
+
+    double min() const
+    {
+        return *std::min_element(nsPerOp.begin(), nsPerOp.end());
+    }
+
+    double median() const
+    {
+        vector<double> sorted = nsPerOp;
+        std::sort(sorted.begin(), sorted.end());
+        int n = sorted.size();
+        return n % 2 == 1 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    }
+
+    double mean() const
+    {
+        return std::accumulate(nsPerOp.begin(), nsPerOp.end(), 0.0) / nsPerOp.size();
+    }
+
+    double stddev() const
+    {
+        double m = mean();
+        double sum = 0;
+        for (double ns : nsPerOp) sum += (ns - m) * (ns - m);
+        return nsPerOp.size() > 1 ? std::sqrt(sum / (nsPerOp.size() - 1)) : 0.0;
+    }
+};
+
+/**
+ * Silences std::cout while in scope, so that progress bars and log messages of the benchmarked code
+ * do not end up in (or slow down) the results.
+ */
+class QuietScope
+{
+public:
+    QuietScope(): saved(std::cout.rdbuf(sink.rdbuf())) {}
+
+    ~QuietScope()
+    {
+        std::cout.rdbuf(saved);
+    }
+
+private:
+    std::ostringstream sink;
+    std::streambuf *saved;
+};
+
+/**
+ * Call f. The call is opaque to the optimizer, otherwise benchmarks without side effects could be moved out of
+ * the timed region (or dropped).
+ */
+template <typename Block>
+__attribute__((noipa)) double runOpaque(Block &f)
+{
+    return f();
+}
+
+static void printHeader()
+{
+    std::cout << std::left << std::setw(56) << "benchmark" << std::right
+              << std::setw(12) << "ops/rep"
+              << std::setw(12) << "min ns/op"
+              << std::setw(12) << "median"
+              << std::setw(12) << "mean"
+              << std::setw(12) << "stddev" << std::endl;
+}
+
+static void printResult(const BenchResult &result)
+{
+    std::cout << std::left << std::setw(56) << result.name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.opsPerRep
+              << std::setw(12) << result.min()
+              << std::setw(12) << result.median()
+              << std::setw(12) << result.mean()
+              << std::setw(12) << result.stddev() << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+}
+
+/**
+ * Run a benchmark once to warm up, then time reps repetitions of it.
+ *
+ * @param name          name of the benchmark
+ * @param opsPerRep     number of operations f does per call
+ * @param reps          number of timed repetitions
+ * @param f             callable f() doing opsPerRep operations, returns a checksum of the results
+ *
+ * @return the timings
+ */
+template <typename Block>
+BenchResult bench(string name, long opsPerRep, int reps, Block f)
+{
+    BenchResult result{name, opsPerRep, {}};
+    double checksum = 0;
+    {
+        QuietScope quiet;
+        checksum += runOpaque(f);
+        for (int rep = 0; rep < reps; rep++)
+        {
+            auto start = Time::now();
+            checksum += runOpaque(f);
+            fsec elapsed = Time::now() - start;
+            result.nsPerOp.push_back(elapsed.count() * 1e9 / opsPerRep);
+        }
+    }
+    volatile double sink = checksum;
+    (void) sink;
+    printResult(result);
+    return result;
+}
+
+/**
+ * @return n points drawn uniformly from the window with a fixed seed
+ */
+static vector<Vec2f> getRandomPoints(Vec4f window, int n, uint64_t seed)
+{
+    pcg32 sampler(seed);
+    vector<Vec2f> points(n);
+    for (Vec2f &p : points)
+    {
+        float x = window[0] + sampler.nextFloat() * (window[2] - window[0]);
+        float y = window[1] + sampler.nextFloat() * (window[3] - window[1]);
+        p = Vec2f(x, y);
+    }
+    return points;
+}
+
+static void writeCSV(string filename, const vector<BenchResult> &results, int reps)
+{
+    std::ofstream out(filename);
+    THROW_IF(!out.is_open(), "Unable to open benchmark file " + filename);
+    out.precision(15);
+    out << "benchmark,ops_per_rep,reps,min_ns,median_ns,mean_ns,stddev_ns" << std::endl;
+    for (const BenchResult &r : results)
+    {
+        out << "\"" << r.name << "\"," << r.opsPerRep << "," << reps << "," << r.min() << "," << r.median() << ","
+            << r.mean() << "," << r.stddev() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    ArgParse parser({
+        Arg("reps", ArgType::INT),
+        Arg("ops", ArgType::INT),
+        Arg("nthreads", ArgType::INT),
+        Arg("res", ArgType::VEC2i),
+        Arg("cellsize", ArgType::FLOAT),
+        Arg("seed", ArgType::INT),
+        Arg("csv", ArgType::STR)
+    });
+    parser.parse(argc, argv);
+
+    int reps = parser.getInt("reps", 10);
+    int nOps = parser.getInt("ops", 1 << 16);
+    int nthreads = parser.getInt("nthreads", omp_get_max_threads());
+    Vec2i res = parser.getVec2i("res", Vec2i(128, 128));
+    float cellSize = parser.getFloat("cellsize", 1);
+    uint64_t seed = parser.getInt("seed", 1);
+    string csvFile = parser.getStr("csv", "");
+    THROW_IF(reps < 1 || nOps < 1 || nthreads < 1, "Benchmark reps, ops and nthreads must be positive.");
+
+    // the kernels count their queries, time only a small fraction of them so the timers hardly add to the results
+    Stats::init(nthreads, 1 << 16);
+
+    vector<BenchResult> results;
+    printHeader();
+
+    // random numbers and step directions
+    long nSamples = 64L * nOps;
+    results.push_back(bench("rng pcg32::nextFloat", nSamples, reps, [nSamples, seed]() -> double
+    {
+        pcg32 sampler(seed);
+        float sum = 0;
+        for (long i = 0; i < nSamples; i++) sum += sampler.nextFloat();
+        return sum;
+    }));
+    results.push_back(bench("rng sampleCirclePoint", nSamples, reps, [nSamples, seed]() -> double
+    {
+        pcg32 sampler(seed);
+        Vec2f sum(0.0f, 0.0f);
+        for (long i = 0; i < nSamples; i++) sum += sampleCirclePoint(1.0f, sampler.nextFloat());
+        return sum.x() + sum.y();
+    }));
+
+    // walk queues: every thread pushes batches into one shared queue and pops whatever is in it
+    const int batchSize = 64;
+    int rounds = std::max(1, nOps / (batchSize * nthreads));
+    long nPushed = long(rounds) * batchSize * nthreads;
+    results.push_back(bench("RandomWalkQueue push+pop (" + to_string(nthreads) + " threads)", nPushed, reps, [nthreads, rounds, batchSize]() -> double
+    {
+        RandomWalkQueue queue;
+        long nPopped = 0;
+        #pragma omp parallel num_threads(nthreads) reduction(+:nPopped)
+        {
+            vector<shared_ptr<RandomWalk>> batch;
+            for (int i = 0; i < batchSize; i++) batch.push_back(make_shared<RandomWalk>(omp_get_thread_num(), i, Vec2f(0.0f, 0.0f), 1));
+            for (int round = 0; round < rounds; round++)
+            {
+                queue.pushBackAll(batch);
+                nPopped += queue.popAllFront().size();
+            }
+        }
+        return nPopped + queue.popAllFront().size();
+    }));
+
+    // writing the rendered image
+    results.push_back(bench("Image::save " + to_string(res.x()) + "x" + to_string(res.y()) + " (per pixel)", long(res.x()) * res.y(), reps, [res, seed]() -> double
+    {
+        Image image(res);
+        pcg32 sampler(seed);
+        for (int i = 0; i < image.getNumPixels(); i++) image.set(i, Vec3f(sampler.nextFloat(), sampler.nextFloat(), sampler.nextFloat()));
+        image.save("pwos_bench");
+        std::remove("pwos_bench.hdr");
+        return image.getNumPixels();
+    }));
+
+    // scene and grid kernels on each scene
+    for (int i = 0; i < parser.getNumMain(); i++)
+    {
+        string filename = parser.getMain(i);
+        shared_ptr<const Scene> scene;
+        try
+        {
+            QuietScope quiet;
+            scene = make_shared<Scene>(filename);
+        }
+        catch (std::exception &e)
+        {
+            WARN_IF(true, "Skipping scene " + filename + ": " + e.what());
+            continue;
+        }
+
+        results.push_back(bench(scene->getName() + " Scene load (per circle)", std::max(1, scene->getNumCircles()), reps, [&filename]() -> double
+        {
+            Scene loaded(filename);
+            return loaded.getNumCircles();
+        }));
+
+        Vec4f window = scene->getWindow();
+        vector<Vec2f> points = getRandomPoints(window, nOps, seed);
+        results.push_back(bench(scene->getName() + " Scene::getClosestPoint", nOps, reps, [&scene, &points]() -> double
+        {
+            Vec3f b;
+            float sum = 0;
+            for (Vec2f p : points) sum += scene->getClosestPoint(p, b).x();
+            return sum;
+        }));
+
+        Vec2f bl(window[0], window[1]);
+        Vec2f tr(window[2], window[3]);
+        float cellLength = cellSize * std::min((tr.x() - bl.x()) / res.x(), (tr.y() - bl.y()) / res.y());
+        shared_ptr<ClosestPointGrid> cpg;
+        {
+            QuietScope quiet;
+            cpg = make_shared<ClosestPointGrid>(scene, bl, tr, cellLength, nthreads);
+        }
+        long nGridPoints = long(cpg->gridWidth) * cpg->gridHeight;
+        results.push_back(bench(scene->getName() + " ClosestPointGrid build (per grid point)", nGridPoints, reps, [&scene, bl, tr, cellLength, nthreads]() -> double
+        {
+            ClosestPointGrid grid(scene, bl, tr, cellLength, nthreads);
+            return grid.grid[0].dist;
+        }));
+
+        vector<Vec2f> gridPoints = getRandomPoints(window, 16 * nOps, seed + 1);
+        results.push_back(bench(scene->getName() + " ClosestPointGrid random lookup", gridPoints.size(), reps, [&cpg, &gridPoints]() -> double
+        {
+            Vec3f b;
+            float dist, gridDist, sum = 0;
+            for (Vec2f p : gridPoints)
+            {
+                cpg->getDistToClosestPoint(p, b, dist, gridDist);
+                sum += dist - gridDist;
+            }
+            return sum;
+        }));
+    }
+
+    if (!csvFile.empty()) writeCSV(csvFile, results, reps);
+}
@@ -8,7 +8,7 @@ GridData::GridData() {};
 
 GridData::GridData(float dist, shared_ptr<Vec3f> b): dist(dist), b(b) {};
 
-ClosestPointGrid::ClosestPointGrid(shared_ptr<Scene> scene, Vec2f bl, Vec2f tr, float cellLength, int nthreads): bl(bl), tr(tr), cellLength(cellLength)
+ClosestPointGrid::ClosestPointGrid(shared_ptr<const Scene> scene, Vec2f bl, Vec2f tr, float cellLength, int nthreads): bl(bl), tr(tr), cellLength(cellLength)
 {
 Stats::TIME(StatTimerType::GRID_CREATION, [this, bl, tr, cellLength, nthreads, scene]() -> void
 {
@@ -17,8 +17,9 @@ Stats::TIME(StatTimerType::GRID_CREATION, [this, bl, tr, cellLength, nthreads, s
 
     gridWidth = ceil(width / cellLength + 1) + 10;
     gridHeight = ceil(height / cellLength + 1) + 10;
+    THROW_IF(gridWidth <= 0 || gridHeight <= 0, "Invalid closest point grid size, the cell length must be positive.");
 
-    grid = new GridData[gridWidth * gridHeight];
+    grid = new GridData[size_t(gridWidth) * size_t(gridHeight)];
 
     // layout grid in memory in blocks (nthreads = 2^n blocks)
     float log2nthreads = log2(nthreads);
@@ -37,11 +38,13 @@ Stats::TIME(StatTimerType::GRID_CREATION, [this, bl, tr, cellLength, nthreads, s
     ProgressBar progress;
     progress.start(nBlocks * blockWidth);
 
-    Stats::SET_COUNT(StatType::GRID_POINTS, gridWidth * gridHeight);
+    Stats::SET_COUNT(StatType::GRID_POINTS, long(gridWidth) * gridHeight);
 
     #pragma omp parallel for num_threads(nthreads)
     for (int bid = 0; bid < nBlocks; bid++)
     {
+        Trace::Scope scope("grid block", bid, true);
+        Stats::ScopedTimer timer(StatTimerType::GRID_CREATION);
         int bidy = bid / nBlockCols;
         int bidx = bid % nBlockCols;
         int maxIdx = std::min(blockWidth, gridWidth - blockWidth * bidx);
@@ -72,6 +75,11 @@ Stats::TIME(StatTimerType::GRID_CREATION, [this, bl, tr, cellLength, nthreads, s
 });
 }
 
+ClosestPointGrid::~ClosestPointGrid()
+{
+    delete[] grid;
+}
+
 bool ClosestPointGrid::getDistToClosestPoint(Vec2f p, Vec3f &b, float &dist, float &gridDist) const
 {
 Stats::INCREMENT_COUNT(StatType::GRID_QUERY);
@@ -0,0 +1,169 @@
+#include <pwos/common.h>
+
+#include <pwos/argparse.h>
+#include <pwos/image.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/stats.h>
+
+#include <iomanip>
+
+// seed of the reference, so that it is independent of the runs it is compared to (which use --seed + rep)
+constexpr uint64_t REFERENCE_SEED = ~uint64_t(0);
+
+// added to the squared reference value of the relative MSE, so that dark pixels do not dominate it
+constexpr double REL_MSE_EPSILON = 1e-2;
+
+/**
+ * Error of an image against the reference.
+ */
+struct ImageError
+{
+    double mse = 0, relMse = 0;
+};
+
+/**
+ * Render an image on fresh Stats.
+ *
+ * @param time      set to the total (setup + render) time in seconds
+ *
+ * @return the rendered image
+ */
+static shared_ptr<Image> render(string integratorType, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, const RenderOptions &options, float &time)
+{
+    Stats::init(nthreads);
+    shared_ptr<Image> image = buildAndRender(integratorType, scene, res, spp, nthreads, options)->getImage();
+    time = Stats::totalTime.count();
+    return image;
+}
+
+/**
+ * @return the MSE and relative MSE over all pixels and channels
+ */
+static ImageError getError(Image &image, Image &reference)
+{
+    Vec2i res = reference.getRes();
+    ImageError error;
+    for (int y = 0; y < res.y(); y++)
+    {
+        for (int x = 0; x < res.x(); x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double ref = reference(x, y)[c];
+                double diff = double(image(x, y)[c]) - ref;
+                error.mse += diff * diff;
+                error.relMse += diff * diff / (ref * ref + REL_MSE_EPSILON);
+            }
+        }
+    }
+    double n = 3.0 * res.x() * res.y();
+    error.mse /= n;
+    error.relMse /= n;
+    return error;
+}
+
+int main(int argc, char* argv[])
+{
+    ArgParse parser({
+        Arg("integrators", ArgType::STR),
+        Arg("spp", ArgType::STR),
+        Arg("nthreads", ArgType::INT),
+        Arg("res", ArgType::VEC2i),
+        Arg("cellsize", ArgType::FLOAT),
+        Arg("sortwalks", ArgType::INT),
+        Arg("tilesize", ArgType::INT),
+        Arg("sppchunk", ArgType::INT),
+        Arg("reps", ArgType::INT),
+        Arg("seed", ArgType::INT),
+        Arg("refintegrator", ArgType::STR),
+        Arg("refspp", ArgType::INT),
+        Arg("refdir", ArgType::STR),
+        Arg("csv", ArgType::STR)
+    });
+    parser.parse(argc, argv);
+
+    vector<string> integrators = parser.getStrList("integrators", "wos,wog,mcwog");
+    vector<int> spps = parser.getIntList("spp", "1,4,16,64");
+    int nthreads = parser.getInt("nthreads", 1);
+    Vec2i res = parser.getVec2i("res", Vec2i(64, 64));
+    RenderOptions options;
+    options.cellSize = parser.getFloat("cellsize", 1);
+    options.sortWalks = parser.getInt("sortwalks", 0) != 0;
+    options.tileSize = parser.getInt("tilesize", 16);
+    options.sampleChunkSize = parser.getInt("sppchunk", 0);
+    int reps = parser.getInt("reps", 1);
+    uint64_t seed = parser.getInt("seed", 0);
+    string refIntegrator = parser.getStr("refintegrator", "wos");
+    int refSpp = parser.getInt("refspp", 4096);
+    string refDir = parser.getStr("refdir", ".");
+    string csvFile = parser.getStr("csv", "convergence.csv");
+    THROW_IF(parser.getNumMain() == 0, "Must specify scene files ./pwos_convergence [scene files]");
+    THROW_IF(reps < 1, "Convergence reps must be at least 1.");
+    for (string type : integrators)
+    {
+        THROW_IF(StrToIntegratorType.count(type) == 0, "Unknown integrator " + type);
+    }
+
+    std::ofstream out(csvFile);
+    THROW_IF(!out.is_open(), "Unable to open convergence file " + csvFile);
+    out.precision(15);
+    out << "scene,integrator,res,spp,nthreads,time,mse,rel_mse,efficiency,rel_efficiency" << std::endl;
+
+    for (int i = 0; i < parser.getNumMain(); i++)
+    {
+        shared_ptr<const Scene> scene = make_shared<Scene>(parser.getMain(i));
+
+        // the reference is rendered once per scene, resolution, spp and cell size, later runs load it
+        Image reference(res);
+        std::stringstream refName;
+        refName << refDir << "/reference_" << scene->getName() << "_" << refIntegrator << "_res=" << res.x() << "x" << res.y()
+            << "_spp=" << refSpp << "_cellsize=" << options.cellSize << ".bin";
+        string refFile = refName.str();
+        if (reference.loadRaw(refFile))
+        {
+            std::cout << "Loaded reference " << refFile << std::endl;
+        }
+        else
+        {
+            float time;
+            samplerSeed = REFERENCE_SEED;
+            reference = *render(refIntegrator, scene, res, refSpp, nthreads, options, time);
+            reference.saveRaw(refFile);
+            std::cout << "Rendered reference " << refFile << " in " << time << " s" << std::endl;
+        }
+
+        std::stringstream table;
+        table << std::left << std::setw(12) << "integrator" << std::right << std::setw(8) << "spp" << std::setw(12) << "time (s)"
+              << std::setw(14) << "MSE" << std::setw(14) << "relMSE" << std::setw(14) << "1/(MSE*t)" << std::setw(14) << "1/(relMSE*t)" << std::endl;
+        for (string type : integrators)
+        {
+            for (int spp : spps)
+            {
+                // average over independent runs, each with its own seed
+                ImageError error;
+                float time = 0;
+                for (int rep = 0; rep < reps; rep++)
+                {
+                    float repTime;
+                    samplerSeed = seed + rep;
+                    shared_ptr<Image> image = render(type, scene, res, spp, nthreads, options, repTime);
+                    ImageError repError = getError(*image, reference);
+                    error.mse += repError.mse / reps;
+                    error.relMse += repError.relMse / reps;
+                    time += repTime / reps;
+                }
+                double efficiency = 1.0 / (error.mse * time);
+                double relEfficiency = 1.0 / (error.relMse * time);
+
+                out << scene->getName() << "," << type << "," << res.x() << "x" << res.y() << "," << spp << "," << nthreads << ","
+                    << time << "," << error.mse << "," << error.relMse << "," << efficiency << "," << relEfficiency << std::endl;
+                table << std::left << std::setw(12) << type << std::right << std::setw(8) << spp << std::setw(12) << time
+                      << std::setw(14) << error.mse << std::setw(14) << error.relMse << std::setw(14) << efficiency
+                      << std::setw(14) << relEfficiency << std::endl;
+            }
+        }
+        std::cout << std::endl << "Efficiency on " << scene->getName() << " (reference: " << refIntegrator << ", " << refSpp << " spp)" << std::endl;
+        std::cout << table.str() << std::endl;
+    }
+}
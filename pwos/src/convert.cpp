@@ -0,0 +1,34 @@
+#include <pwos/common.h>
+
+#include <pwos/argparse.h>
+#include <pwos/scene.h>
+
+int main(int argc, char* argv[])
+{
+    ArgParse parser({
+        Arg("odir", ArgType::STR)
+    });
+    parser.parse(argc, argv);
+
+    string outDir = parser.getStr("odir", "");
+    THROW_IF(parser.getNumMain() == 0, "Must specify scene files ./pwos_convert [scene files]");
+
+    for (int i = 0; i < parser.getNumMain(); i++)
+    {
+        string filename = parser.getMain(i);
+        Scene scene(filename);
+
+        // written next to the input unless an output directory is given
+        size_t lastSlashIndex = filename.find_last_of("/");
+        string dir = !outDir.empty() ? outDir
+            : lastSlashIndex == string::npos ? "." : filename.substr(0, lastSlashIndex);
+        string outFile = dir + "/" + scene.getName() + ".pwos";
+        THROW_IF(outFile == filename, "Converting " + filename + " would overwrite it");
+        scene.saveBinary(outFile);
+
+        // load it back to make sure the file is valid
+        Scene check(outFile);
+        THROW_IF(check.getNumCircles() != scene.getNumCircles(), "Converted scene " + outFile + " does not match " + filename);
+        std::cout << "Wrote " << outFile << std::endl;
+    }
+}
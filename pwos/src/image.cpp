@@ -1,7 +1,5 @@
 #include <pwos/common.h>
-#include <pwos/progressBar.h>
 #include <pwos/image.h>
-#include <pwos/stats.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
@@ -23,27 +21,14 @@ Vec3f& Image::operator()(int x, int y)
     return data[idx];
 }
 
-void Image::render(Vec4f window, int nthreads, Rand2DFunction f)
-{   
-    ProgressBar progress;
-    progress.start(getNumPixels());
+void Image::setSampleChunkSize(int sampleChunkSize)
+{
+    this->sampleChunkSize = sampleChunkSize;
+}
 
-    #pragma omp parallel num_threads(nthreads)
-    {
-        size_t tid = omp_get_thread_num();
-        pcg32 sampler = getSampler(tid);
-        #pragma omp for 
-        for (int i = 0; i < getNumPixels(); i++)
-        {
-Stats::TIME_THREAD(StatTimerType::TOTAL, [this, i, f, window, &sampler]() -> void {
-            Vec2i pixel = getPixelCoordinates(i);
-            Vec2f coord = getXYCoords(pixel, window, res);
-            set(i, f(coord, sampler));
-});
-            progress++;
-        }
-    }
-    progress.finish();
+void Image::setTileSize(int tileSize)
+{
+    this->tileSize = tileSize;
 }
 
 void Image::save(string filename)
@@ -61,6 +46,27 @@ void Image::save(string filename)
     delete raw_data;
 }
 
+void Image::saveRaw(string filename)
+{
+    std::ofstream out(filename, std::ios::binary);
+    THROW_IF(!out.is_open(), "Unable to open " + filename);
+    out.write((const char*) res.data(), sizeof(int) * 2);
+    out.write((const char*) data.data(), sizeof(Vec3f) * data.size());
+    THROW_IF(!out, "Failed to write " + filename);
+}
+
+bool Image::loadRaw(string filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) return false;
+    Vec2i fileRes;
+    in.read((char*) fileRes.data(), sizeof(int) * 2);
+    THROW_IF(fileRes != res, filename + " has resolution " + to_string(fileRes.x()) + "x" + to_string(fileRes.y()) + ", expected " + to_string(res.x()) + "x" + to_string(res.y()));
+    in.read((char*) data.data(), sizeof(Vec3f) * data.size());
+    THROW_IF(!in, "Failed to read " + filename);
+    return true;
+}
+
 Vec2i Image::getRes()
 {
     return res;
@@ -2,16 +2,28 @@
 
 #include <pwos/circle.h>
 #include <pwos/integrator.h>
-#include <pwos/integrators/wos.h>
 #include <pwos/image.h>
 #include <pwos/scene.h>
+#include <pwos/stats.h>
+
+#include <pwos/integrators/wos.h>
+#include <pwos/integrators/wosPacket.h>
+#include <pwos/integrators/distance.h>
+#include <pwos/integrators/gridVisual.h>
+#include <pwos/integrators/wog.h>
+#include <pwos/integrators/wogCoroutine.h>
+#include <pwos/integrators/wogPacket.h>
+#include <pwos/integrators/wogVisual.h>
+#include <pwos/integrators/mcwogVisual.h>
+#include <pwos/integrators/mcwog.h>
+#include <pwos/integrators/wavefront.h>
 
-Integrator::Integrator(string name, Scene scene, Vec2i res, int spp, int nthreads)
+Integrator::Integrator(string name, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads)
 : name(name)
 , spp(spp)
 , nthreads(nthreads)
+, scene(scene)
 {
-    this->scene = make_shared<Scene>(scene);
     image = make_shared<Image>(res);
 }
 
@@ -25,3 +37,65 @@ void Integrator::save()
     string filename = name + "_scene=" + scene->getName() + "_spp=" + to_string(spp) + "_nthreads=" + to_string(nthreads);
     image->save(filename);
 }
+
+shared_ptr<Image> Integrator::getImage()
+{
+    return image;
+}
+
+void Integrator::setTileSize(int tileSize)
+{
+    image->setTileSize(tileSize);
+}
+
+void Integrator::setSampleChunkSize(int sampleChunkSize)
+{
+    image->setSampleChunkSize(sampleChunkSize);
+}
+
+shared_ptr<Integrator> buildIntegrator(string type, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, float cellSize, bool sortWalks)
+{
+    switch(StrToIntegratorType.at(type))
+    {
+        case IntegratorType::GRID_VISUAL:
+            return make_shared<GridVisual>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::DISTANCE:
+            return make_shared<Distance>(scene, res, spp, nthreads);
+        case IntegratorType::MCWOG:
+            return make_shared<MCWoG>(scene, res, spp, nthreads, cellSize, sortWalks);
+        case IntegratorType::MCWOG_VISUAL:
+            return make_shared<MCWoGVisual>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WOG:
+            return make_shared<WoG>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WOG_VISUAL:
+            return make_shared<WoGVisual>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WOG_PACKET:
+            return make_shared<WoGPacket>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WOG_COROUTINE:
+            return make_shared<WoGCoroutine>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WAVEFRONT:
+            return make_shared<Wavefront>(scene, res, spp, nthreads, cellSize);
+        case IntegratorType::WOS_PACKET:
+            return make_shared<WoSPacket>(scene, res, spp, nthreads);
+        case IntegratorType::WOS:
+        default:
+            return make_shared<WoS>(scene, res, spp, nthreads);
+    }
+}
+
+shared_ptr<Integrator> buildAndRender(string type, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, const RenderOptions &options)
+{
+    Stats::SET_COUNT(StatType::WALKS, long(res.x()) * res.y() * spp);
+    shared_ptr<Integrator> integrator;
+Stats::TIME(StatTimerType::TOTAL, [&integrator, type, &scene, res, spp, nthreads, &options]()->void {
+Stats::TIME(StatTimerType::SETUP, [&integrator, type, &scene, res, spp, nthreads, &options]()->void {
+        integrator = buildIntegrator(type, scene, res, spp, nthreads, options.cellSize, options.sortWalks);
+        integrator->setTileSize(options.tileSize);
+        integrator->setSampleChunkSize(options.sampleChunkSize);
+});
+Stats::TIME(StatTimerType::RENDER, [&integrator]()->void {
+        integrator->render();
+});
+});
+    return integrator;
+}
@@ -2,38 +2,10 @@
 
 #include <pwos/argparse.h>
 #include <pwos/image.h>
+#include <pwos/integrator.h>
 #include <pwos/scene.h>
 #include <pwos/stats.h>
-
-#include <pwos/integrators/wos.h>
-#include <pwos/integrators/distance.h>
-#include <pwos/integrators/gridVisual.h>
-#include <pwos/integrators/wog.h>
-#include <pwos/integrators/wogVisual.h>
-#include <pwos/integrators/mcwogVisual.h>
-#include <pwos/integrators/mcwog.h>
-
-shared_ptr<Integrator> buildIntegrator(string type, Scene scene, Vec2i res, int spp, int nthreads, float cellSize)
-{
-    switch(StrToIntegratorType.at(type))
-    {
-        case IntegratorType::GRID_VISUAL:
-            return make_shared<GridVisual>(scene, res, spp, nthreads, cellSize);
-        case IntegratorType::DISTANCE:
-            return make_shared<Distance>(scene, res, spp, nthreads);
-        case IntegratorType::MCWOG:
-            return make_shared<MCWoG>(scene, res, spp, nthreads, cellSize);
-        case IntegratorType::MCWOG_VISUAL:
-            return make_shared<MCWoGVisual>(scene, res, spp, nthreads, cellSize);
-        case IntegratorType::WOG:
-            return make_shared<WoG>(scene, res, spp, nthreads, cellSize);
-        case IntegratorType::WOG_VISUAL:
-            return make_shared<WoGVisual>(scene, res, spp, nthreads, cellSize);
-        case IntegratorType::WOS:
-        default:
-            return make_shared<WoS>(scene, res, spp, nthreads);
-    }
-}
+#include <pwos/trace.h>
 
 int main(int argc, char* argv[])
 {
@@ -43,7 +15,17 @@ int main(int argc, char* argv[])
         Arg("nthreads", ArgType::INT),
         Arg("res", ArgType::VEC2i),
         Arg("integrator", ArgType::STR),
-        Arg("cellsize", ArgType::FLOAT)
+        Arg("cellsize", ArgType::FLOAT),
+        Arg("sortwalks", ArgType::INT),
+        Arg("tilesize", ArgType::INT),
+        Arg("sppchunk", ArgType::INT),
+        Arg("timersample", ArgType::INT),
+        Arg("seed", ArgType::INT),
+        Arg("trace", ArgType::STR),
+        Arg("tracesize", ArgType::INT),
+        Arg("stats-json", ArgType::STR),
+        Arg("stats-csv", ArgType::STR),
+        Arg("perf", ArgType::INT)
     });
 
     // parse
@@ -55,20 +37,41 @@ int main(int argc, char* argv[])
     Vec2i res = parser.getVec2i("res", Vec2i(128, 128));
     string integratorType = parser.getStr("integrator", "wos");
     float cellSize = parser.getFloat("cellsize", 1);
+    bool sortWalks = parser.getInt("sortwalks", 0) != 0;
+    int tileSize = parser.getInt("tilesize", 16);
+    int sampleChunkSize = parser.getInt("sppchunk", 0);
+    int timerSampleRate = parser.getInt("timersample", 1);
+    samplerSeed = parser.getInt("seed", 0);
+    string traceFile = parser.getStr("trace", "");
+    int traceSize = parser.getInt("tracesize", 1 << 18);
+    string statsJsonFile = parser.getStr("stats-json", "");
+    string statsCsvFile = parser.getStr("stats-csv", "");
+    bool perfCounters = parser.getInt("perf", 0) != 0;
 
-    // create the scene
-    Scene scene(parser.getMain(0, "Must specify scene file ./pwos [scene file]"));
+    // create the scene, it is shared by everything that renders it
+    shared_ptr<const Scene> scene = make_shared<Scene>(parser.getMain(0, "Must specify scene file ./pwos [scene file]"));
 
-    Stats::init(nthreads);
+    Stats::init(nthreads, timerSampleRate);
+    if (!traceFile.empty()) Trace::init(nthreads, traceSize);
+    if (perfCounters) PerfCounters::init();
+    Stats::SET_CONFIG("scene", scene->getName());
+    Stats::SET_CONFIG("integrator", integratorType);
+    Stats::SET_CONFIG("spp", to_string(spp));
+    Stats::SET_CONFIG("res", to_string(res.x()) + "x" + to_string(res.y()));
+    Stats::SET_CONFIG("cellsize", to_string(cellSize));
+    Stats::SET_CONFIG("nthreads", to_string(nthreads));
+    Stats::SET_CONFIG("sortwalks", to_string(sortWalks));
+    Stats::SET_CONFIG("tilesize", to_string(tileSize));
+    Stats::SET_CONFIG("sppchunk", to_string(sampleChunkSize));
+    Stats::SET_CONFIG("timersample", to_string(timerSampleRate));
+    Stats::SET_CONFIG("seed", to_string(samplerSeed));
 
     // build and run the integrator.
-    shared_ptr<Integrator> integrator;
-Stats::TIME(StatTimerType::TOTAL, [&integrator, integratorType, scene, res, spp, nthreads, cellSize]()->void {
-Stats::TIME(StatTimerType::SETUP, [&integrator, integratorType, scene, res, spp, nthreads, cellSize]()->void {
-        integrator = buildIntegrator(integratorType, scene, res, spp, nthreads, cellSize);
-});
-        integrator->render();
-});
+    RenderOptions options{cellSize, sortWalks, tileSize, sampleChunkSize};
+    shared_ptr<Integrator> integrator = buildAndRender(integratorType, scene, res, spp, nthreads, options);
     Stats::report();
+    if (!traceFile.empty()) Trace::write(traceFile);
+    if (!statsJsonFile.empty()) Stats::writeJSON(statsJsonFile);
+    if (!statsCsvFile.empty()) Stats::writeCSV(statsCsvFile);
     integrator->save();
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include <pwos/common.h>
+#include <pwos/mappedFile.h>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(string filename)
+{
+#ifdef __unix__
+    int fd = open(filename.c_str(), O_RDONLY);
+    THROW_IF(fd < 0, "Unable to open file " + filename);
+    struct stat st;
+    bool hasSize = fstat(fd, &st) == 0;
+    if (hasSize && st.st_size > 0)
+    {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            bytes = static_cast<const char*>(addr);
+            numBytes = st.st_size;
+            mapped = true;
+        }
+    }
+    close(fd);
+    if (mapped || (hasSize && st.st_size == 0)) return;
+#endif
+
+    // no mmap, read the whole file
+    ifstream in(filename, std::ios::binary | std::ios::ate);
+    THROW_IF(!in.is_open(), "Unable to open file " + filename);
+    buffer.resize(in.tellg());
+    in.seekg(0);
+    in.read(buffer.data(), buffer.size());
+    THROW_IF(!in, "Unable to read file " + filename);
+    bytes = buffer.empty() ? nullptr : buffer.data();
+    numBytes = buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef __unix__
+    if (mapped) munmap(const_cast<char*>(bytes), numBytes);
+#endif
+}
@@ -0,0 +1,108 @@
+#include <pwos/common.h>
+#include <pwos/perfCounters.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+/**
+ * The counter group of one thread.
+ */
+struct PerfGroup
+{
+    // file descriptor of each event, -1 if it could not be opened
+    int fds[NUM_PERF_EVENTS] = { -1, -1, -1, -1 };
+
+    // the fd that reads the whole group
+    int leader = -1;
+
+    // true once opening was attempted
+    bool opened = false;
+
+    ~PerfGroup()
+    {
+#ifdef __linux__
+        for (int fd : fds)
+        {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    /**
+     * Open every event that is available, the first one that opens leads the group.
+     */
+    void open()
+    {
+        opened = true;
+#ifdef __linux__
+        const uint64_t configs[NUM_PERF_EVENTS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < NUM_PERF_EVENTS; i++)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = leader < 0;
+
+            // count the calling thread on any cpu
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fds[i] >= 0 && leader < 0) leader = fds[i];
+        }
+        if (leader >= 0)
+        {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+};
+
+// counters are per OS thread, so the group lives in thread local storage
+static thread_local PerfGroup group;
+
+void PerfCounters::init()
+{
+    if (!group.opened) group.open();
+    int nAvailable = 0;
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        available[i] = group.fds[i] >= 0;
+        nAvailable += available[i];
+        WARN_IF(!available[i] && group.leader >= 0, string("Hardware counter ") + getPerfEventName(PerfEvent(i)) + " is not available and will be reported as 0.");
+    }
+    enabled = nAvailable > 0;
+    WARN_IF(!enabled, "Hardware counters are not available (perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid), continuing without them.");
+}
+
+bool PerfCounters::read(uint64_t values[NUM_PERF_EVENTS])
+{
+    if (!group.opened) group.open();
+    if (group.leader < 0) return false;
+#ifdef __linux__
+    // group read format: number of events, then their values in the order they were opened
+    uint64_t buffer[1 + NUM_PERF_EVENTS];
+    if (::read(group.leader, buffer, sizeof(buffer)) <= 0) return false;
+    int next = 1;
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        values[i] = group.fds[i] >= 0 ? buffer[next++] : 0;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
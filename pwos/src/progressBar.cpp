@@ -0,0 +1,135 @@
+#include <pwos/common.h>
+#include <pwos/progressBar.h>
+#include <pwos/stats.h>
+
+#include <cstdio>
+#include <sstream>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+/**
+ * @return true if stdout is an interactive terminal
+ */
+static bool isTerminal()
+{
+#ifdef __unix__
+    return isatty(fileno(stdout));
+#else
+    return true;
+#endif
+}
+
+/**
+ * Format a rate with an SI prefix, e.g. "12.3 M".
+ */
+static string formatRate(double rate)
+{
+    const char *prefixes[] = { "", "k", "M", "G", "T" };
+    int i = 0;
+    while (rate >= 1000.0 && i < 4)
+    {
+        rate /= 1000.0;
+        i++;
+    }
+    std::ostringstream out;
+    out.precision(3);
+    out << rate << " " << prefixes[i];
+    return out.str();
+}
+
+ProgressBar::~ProgressBar()
+{
+    stopReporter();
+}
+
+void ProgressBar::start(long totalWork, double walksPerUnit)
+{
+    stopReporter();
+    this->totalWork = totalWork;
+    this->walksPerUnit = walksPerUnit;
+    counters = vector<Counter>(std::max(omp_get_max_threads(), omp_get_num_procs()) + 1);
+    initSteps = Stats::getNumWalkSteps();
+    drawing = isTerminal();
+    startTime = Time::now();
+    if (!drawing) return;
+
+    draw(0);
+    stopRequested = false;
+    reporter = std::thread(&ProgressBar::report, this);
+}
+
+long ProgressBar::getWorkCompleted()
+{
+    long workCompleted = 0;
+    for (Counter &counter : counters)
+    {
+        workCompleted += std::atomic_ref<long>(counter.count).load(std::memory_order_relaxed);
+    }
+    return workCompleted;
+}
+
+void ProgressBar::report()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wakeUp.wait_for(lock, interval, [this]() -> bool { return stopRequested; }))
+    {
+        draw(getWorkCompleted());
+    }
+}
+
+void ProgressBar::stopReporter()
+{
+    if (!reporter.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wakeUp.notify_one();
+    reporter.join();
+}
+
+void ProgressBar::finish()
+{
+    stopReporter();
+    fsec duration = Time::now() - startTime;
+    if (drawing)
+    {
+        draw(totalWork);
+        std::cout << std::endl;
+    }
+    std::cout << "Finished in " <<  duration.count() << " s" << std::endl;
+}
+
+void ProgressBar::draw(long workCompleted)
+{
+    float progress = totalWork > 0 ? std::min(1.0f, float(workCompleted) / totalWork) : 1.0f;
+    double elapsed = fsec(Time::now() - startTime).count();
+
+    // build the whole line first so that it is written at once
+    std::ostringstream line;
+    line << "[";
+    int pos = barWidth * progress;
+    for (int i = 0; i < barWidth; ++i)
+    {
+        if (i < pos) line << "=";
+        else if (i == pos) line << ">";
+        else line << " ";
+    }
+    line << "] " << int(progress * 100.0) << " %";
+
+    if (elapsed > 0.0)
+    {
+        if (walksPerUnit > 0) line << " | " << formatRate(workCompleted * walksPerUnit / elapsed) << "walks/s";
+        long steps = Stats::getNumWalkSteps() - initSteps;
+        if (steps > 0) line << " | " << formatRate(steps / elapsed) << "steps/s";
+    }
+    if (workCompleted > 0 && workCompleted < totalWork)
+    {
+        line << " | ETA " << int(std::ceil(elapsed * (totalWork - workCompleted) / workCompleted)) << " s";
+    }
+
+    // clear what is left of a longer previous line
+    std::cout << line.str() << "\033[K\r" << std::flush;
+}
@@ -9,12 +9,15 @@ RandomWalk::RandomWalk(int parentId, int pixelId, Vec2f p, int nSamples)
     : parentId(parentId)
     , pixelId(pixelId)
     , startP(p)
+    , p(p)
+    , f(1.0f)
+    , currSteps(0)
     , val(Vec3f(0.0f, 0.0f, 0.0f))
     , nSamplesLeft(nSamples)
     , terminated(false)
-    , f(1.0f)
-    , p(startP)
-    , currSteps(0) {};
+    , sample(0)
+    , sampler(getSampler(pixelId, 0))
+    , hasStartQuery(false) {};
 
 void RandomWalk::initializeWalk()
 {
@@ -22,6 +25,8 @@ void RandomWalk::initializeWalk()
     f = 1.0f;
     p = startP;
     currSteps = 0;
+    sample++;
+    sampler = getSampler(pixelId, sample);
 }
 
 void RandomWalk::takeStep(Vec2f stepVec, float fUpdate)
@@ -101,11 +106,11 @@ vector<shared_ptr<RandomWalk>> RandomWalkQueue::popAllFront()
 }
 
 RandomWalkManager::RandomWalkManager(shared_ptr<RandomWalkManager> rwm, size_t tid)
-: tid(tid)
-, nthreads(rwm->nthreads)
+: nthreads(rwm->nthreads)
+, cpg(rwm->cpg)
+, tid(tid)
 , activeWalks(rwm->activeWalks)
 , terminatedWalks(rwm->terminatedWalks)
-, cpg(rwm->cpg)
 {
     // setup new buffers
     activeWalksSendBuffer = vector<vector<shared_ptr<RandomWalk>>>();
@@ -120,9 +125,9 @@ RandomWalkManager::RandomWalkManager(shared_ptr<RandomWalkManager> rwm, size_t t
 }
 
 RandomWalkManager::RandomWalkManager(shared_ptr<ClosestPointGrid> cpg, Vec4f window, Vec2i res, int spp, int nthreads)
-: tid(0)
+: nthreads(nthreads)
 , cpg(cpg)
-, nthreads(nthreads)
+, tid(0)
 {
     // create all of the dequeues to be used
     for (int i = 0; i < nthreads * nthreads; i++)
@@ -150,7 +155,9 @@ RandomWalkManager::RandomWalkManager(shared_ptr<ClosestPointGrid> cpg, Vec4f win
             addWalkToBuffer(getParentId(coord), rw);
         }
     }
-    sendWalks();
+
+    // initial distribution of the walks, not part of the traffic between threads
+    flushSendBuffers();
     progress.finish();
 };
 
@@ -205,6 +212,8 @@ Stats::TIME_THREAD(StatTimerType::RECV_WALKS, [this, &rws]() -> void {
     // extra cleanup, clear our own send buffer
     activeWalksSendBuffer[tid].clear();
 });
+    // idle threads poll their queue, only rounds with work count towards the queue depth
+    if (!rws.empty()) Stats::RECORD_ROUND(rws.size());
     return rws;
 }
 
@@ -241,6 +250,16 @@ Stats::TIME_THREAD(StatTimerType::RECV_WALKS, [this, &rws]() -> void {
 void RandomWalkManager::sendWalks()
 {
 Stats::TIME_THREAD(StatTimerType::SEND_WALKS, [this]() -> void {
+    for (int i = 0; i < nthreads; i++)
+    {
+        Stats::RECORD_TRAFFIC(i, activeWalksSendBuffer[i].size(), terminatedWalksSendBuffer[i].size());
+    }
+    flushSendBuffers();
+});
+}
+
+void RandomWalkManager::flushSendBuffers()
+{
     for (int i = 0; i < nthreads; i++)
     {
         if (tid != i)
@@ -260,7 +279,6 @@ Stats::TIME_THREAD(StatTimerType::SEND_WALKS, [this]() -> void {
             }
         }
     }
-});
 }
 
 void RandomWalkManager::addWalkToBuffer(int receiver, shared_ptr<RandomWalk> rw)
@@ -0,0 +1,135 @@
+#include <pwos/common.h>
+
+#include <pwos/argparse.h>
+#include <pwos/integrator.h>
+#include <pwos/scene.h>
+#include <pwos/stats.h>
+
+/**
+ * Times of one run, taken from Stats.
+ */
+struct RunTimes
+{
+    float setup, render, total;
+
+    long steps;
+};
+
+/**
+ * @return true if the integrator builds a closest point grid (so that its cell size matters)
+ */
+static bool usesGrid(string type)
+{
+    IntegratorType t = StrToIntegratorType.at(type);
+    return t != IntegratorType::WOS && t != IntegratorType::WOS_PACKET && t != IntegratorType::DISTANCE;
+}
+
+/**
+ * Time one run on fresh Stats.
+ */
+static RunTimes run(string integratorType, shared_ptr<const Scene> scene, Vec2i res, int spp, int nthreads, const RenderOptions &options)
+{
+    Stats::init(nthreads);
+    buildAndRender(integratorType, scene, res, spp, nthreads, options);
+    return RunTimes{Stats::setupTime.count(), Stats::renderTime.count(), Stats::totalTime.count(), Stats::getNumWalkSteps()};
+}
+
+int main(int argc, char* argv[])
+{
+    ArgParse parser({
+        Arg("integrators", ArgType::STR),
+        Arg("threads", ArgType::STR),
+        Arg("res", ArgType::STR),
+        Arg("cellsize", ArgType::STR),
+        Arg("spp", ArgType::INT),
+        Arg("reps", ArgType::INT),
+        Arg("weak", ArgType::INT),
+        Arg("sortwalks", ArgType::INT),
+        Arg("tilesize", ArgType::INT),
+        Arg("sppchunk", ArgType::INT),
+        Arg("csv", ArgType::STR)
+    });
+    parser.parse(argc, argv);
+
+    // powers of two up to the number of cores
+    string defaultThreads = "1";
+    for (int n = 2; n <= omp_get_num_procs(); n *= 2) defaultThreads += "," + to_string(n);
+
+    vector<string> integrators = parser.getStrList("integrators", "wos,wog,mcwog");
+    vector<int> threads = parser.getIntList("threads", defaultThreads);
+    vector<int> resolutions = parser.getIntList("res", "128");
+    vector<float> cellSizes = parser.getFloatList("cellsize", "1");
+    int spp = parser.getInt("spp", 16);
+    int reps = parser.getInt("reps", 1);
+    bool weak = parser.getInt("weak", 0) != 0;
+    RenderOptions options;
+    options.sortWalks = parser.getInt("sortwalks", 0) != 0;
+    options.tileSize = parser.getInt("tilesize", 16);
+    options.sampleChunkSize = parser.getInt("sppchunk", 0);
+    string csvFile = parser.getStr("csv", "scaling.csv");
+    THROW_IF(parser.getNumMain() == 0, "Must specify scene files ./pwos_scaling [scene files]");
+    THROW_IF(reps < 1, "Scaling reps must be at least 1.");
+    for (string type : integrators)
+    {
+        THROW_IF(StrToIntegratorType.count(type) == 0, "Unknown integrator " + type);
+    }
+
+    std::ofstream out(csvFile);
+    THROW_IF(!out.is_open(), "Unable to open scaling file " + csvFile);
+    out.precision(15);
+    out << "scaling,scene,integrator,res,cellsize,spp,nthreads,setup_time,render_time,total_time,walks_per_sec,steps_per_sec,speedup,efficiency" << std::endl;
+
+    vector<string> modes = { "strong" };
+    if (weak) modes.push_back("weak");
+
+    for (int i = 0; i < parser.getNumMain(); i++)
+    {
+        shared_ptr<const Scene> scene = make_shared<Scene>(parser.getMain(i));
+        for (string type : integrators)
+        {
+            for (int r : resolutions)
+            {
+                // the cell size only matters to integrators with a grid
+                int nCellSizes = usesGrid(type) ? cellSizes.size() : 1;
+                for (int c = 0; c < nCellSizes; c++)
+                {
+                    for (string mode : modes)
+                    {
+                        // speedup and efficiency are relative to the first thread count
+                        float baseTime = 0;
+                        for (int nthreads : threads)
+                        {
+                            // weak scaling keeps the samples per thread fixed
+                            int runSpp = mode == "weak" ? std::max(1, spp * nthreads / threads[0]) : spp;
+
+                            // keep the fastest of the repetitions
+                            RunTimes best{};
+                            for (int rep = 0; rep < reps; rep++)
+                            {
+                                RenderOptions runOptions = options;
+                                runOptions.cellSize = cellSizes[c];
+                                RunTimes times = run(type, scene, Vec2i(r, r), runSpp, nthreads, runOptions);
+                                if (rep == 0 || times.total < best.total) best = times;
+                            }
+
+                            if (baseTime == 0) baseTime = best.total;
+                            // strong: same work in less time, weak: scale times the work in the same time.
+                            // the weak scale is the actual work ratio, runSpp is rounded when threads[0] does not divide it
+                            float scale = mode == "weak" ? float(runSpp) / spp : float(nthreads) / threads[0];
+                            float speedup = mode == "weak" ? scale * baseTime / best.total : baseTime / best.total;
+                            float efficiency = speedup / scale;
+                            long walks = long(r) * r * runSpp;
+
+                            out << mode << "," << scene->getName() << "," << type << "," << r << "," << cellSizes[c] << "," << runSpp << ","
+                                << nthreads << "," << best.setup << "," << best.render << "," << best.total << ","
+                                << double(walks) / best.render << "," << double(best.steps) / best.render << "," << speedup << "," << efficiency << std::endl;
+                            std::cout << "[" << mode << "] " << scene->getName() << " " << type << " res=" << r << " cellsize=" << cellSizes[c]
+                                      << " spp=" << runSpp << " nthreads=" << nthreads << ": " << best.total << " s, speedup=" << speedup
+                                      << ", efficiency=" << efficiency << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
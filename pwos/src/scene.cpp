@@ -1,83 +1,271 @@
 #include <pwos/common.h>
 #include <pwos/scene.h>
-#include <pwos/circle.h>
+#include <pwos/mappedFile.h>
 #include <pwos/stats.h>
 
-Scene::Scene(string filename)
+#include <array>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <unordered_map>
+
+/**
+ * @return offset rounded up to the alignment of the arrays of binary scene files
+ */
+static uint64_t alignSceneOffset(uint64_t offset)
+{
+    return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+}
+
+/**
+ * Lay out circles as a binary scene file, boundary values that are used by several circles are stored once.
+ *
+ * @param window    scene window
+ * @param x         x coordinates of the centers
+ * @param y         y coordinates of the centers
+ * @param r         radii
+ * @param b         boundary values
+ *
+ * @return the contents of the file
+ */
+static shared_ptr<vector<char>> buildSceneFile(Vec4f window, const vector<float> &x, const vector<float> &y,
+    const vector<float> &r, const vector<Vec3f> &b)
+{
+    // palette of the distinct boundary values (compared bitwise)
+    auto hashColor = [](const std::array<uint32_t, 3> &key) -> size_t
+    {
+        return mixBits((uint64_t(key[0]) << 32 | key[1]) ^ mixBits(key[2]));
+    };
+    std::unordered_map<std::array<uint32_t, 3>, uint32_t, decltype(hashColor)> colorIndex(b.size(), hashColor);
+    vector<uint32_t> boundary(b.size());
+    vector<float> palette;
+    for (size_t i = 0; i < b.size(); i++)
+    {
+        std::array<uint32_t, 3> key;
+        std::memcpy(key.data(), b[i].data(), sizeof(key));
+        auto it = colorIndex.find(key);
+        if (it == colorIndex.end())
+        {
+            it = colorIndex.emplace(key, uint32_t(colorIndex.size())).first;
+            palette.insert(palette.end(), { b[i].x(), b[i].y(), b[i].z() });
+        }
+        boundary[i] = it->second;
+    }
+
+    uint64_t n = x.size();
+    SceneFileHeader header = {};
+    std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC));
+    header.version = SCENE_FILE_VERSION;
+    header.numCircles = n;
+    header.numColors = palette.size() / 3;
+    for (int i = 0; i < 4; i++) header.window[i] = window[i];
+    header.xOffset = alignSceneOffset(sizeof(SceneFileHeader));
+    header.yOffset = alignSceneOffset(header.xOffset + n * sizeof(float));
+    header.radiusOffset = alignSceneOffset(header.yOffset + n * sizeof(float));
+    header.boundaryOffset = alignSceneOffset(header.radiusOffset + n * sizeof(float));
+    header.paletteOffset = alignSceneOffset(header.boundaryOffset + n * sizeof(uint32_t));
+    header.fileSize = header.paletteOffset + palette.size() * sizeof(float);
+
+    shared_ptr<vector<char>> file = make_shared<vector<char>>(header.fileSize, 0);
+    char *data = file->data();
+    std::memcpy(data, &header, sizeof(header));
+    std::memcpy(data + header.xOffset, x.data(), n * sizeof(float));
+    std::memcpy(data + header.yOffset, y.data(), n * sizeof(float));
+    std::memcpy(data + header.radiusOffset, r.data(), n * sizeof(float));
+    std::memcpy(data + header.boundaryOffset, boundary.data(), n * sizeof(uint32_t));
+    std::memcpy(data + header.paletteOffset, palette.data(), palette.size() * sizeof(float));
+    return file;
+}
+
+// CSV scene files are split into chunks of at least this many bytes, which are parsed in parallel
+constexpr long MIN_CSV_CHUNK_SIZE = 1 << 20;
+
+// names of the values of a circle in a CSV scene file, in order
+static const char *CIRCLE_FIELDS[6] = {
+    "x coordinate", "y coordinate", "radius", "boundary red value", "boundary green value", "boundary blue value"
+};
+
+enum class CellStatus
 {
-    ifstream in(filename.c_str());
-    THROW_IF(!in.is_open(), "Unable to open file " + filename);
+    OK,
+    EMPTY,
+    INVALID
+};
 
+/**
+ * @return the end of the line starting at p (the newline, or end if there is none)
+ */
+static const char* findLineEnd(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+/**
+ * Parse the number in the CSV cell at p and move p to the next cell. Like stof, leading whitespace
+ * and anything after the number are ignored.
+ *
+ * @param p         start of the cell, set to the start of the next cell
+ * @param lineEnd   end of the line
+ * @param value     set to the number
+ *
+ * @return OK, EMPTY if the cell is empty, INVALID if it does not start with a number
+ */
+static CellStatus parseCell(const char *&p, const char *lineEnd, float &value)
+{
+    const char *cell = p;
+    const char *cellEnd = static_cast<const char*>(std::memchr(p, ',', lineEnd - p));
+    if (!cellEnd) cellEnd = lineEnd;
+    p = cellEnd < lineEnd ? cellEnd + 1 : lineEnd;
+
+    while (cell < cellEnd && (*cell == ' ' || *cell == '\t')) cell++;
+    if (cell < cellEnd && *cell == '+') cell++;
+    if (cell == cellEnd || *cell == '\r') return CellStatus::EMPTY;
+    return std::from_chars(cell, cellEnd, value).ec == std::errc() ? CellStatus::OK : CellStatus::INVALID;
+}
+
+Scene::Scene(string filename)
+{
     size_t lastSlashIndex = filename.find_last_of("/");
     string fileWithoutPath = filename.substr(lastSlashIndex + 1, filename.size() - 1);
 
     size_t lastPeriodIndex= fileWithoutPath.find_last_of(".");
     name = fileWithoutPath.substr(0, lastPeriodIndex);
 
-    string line;
-    string cell;
-    stringstream ss;
+    // binary scene files are used in place, anything else is parsed as CSV
+    shared_ptr<MappedFile> file = make_shared<MappedFile>(filename);
+    if (file->size() >= sizeof(SCENE_FILE_MAGIC) && std::memcmp(file->data(), SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) == 0)
+    {
+        setArrays(file->data(), file->size(), filename);
+        storage = file;
+    }
+    else
+    {
+        loadCSV(*file, filename);
+    }
 
-    // get the first line (the window)
-    getline(in, line);
-    THROW_IF(line.empty(), "No lines in scene file to read, must have at least one line with window.");
+    std::cout << "Scene loading finished. Loaded " << numCircles << " circles." << std::endl;
+}
 
-    ss.clear();
-    ss.str(line);
+void Scene::loadCSV(const MappedFile &file, string filename)
+{
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    THROW_IF(begin == end, "No lines in scene file to read, must have at least one line with window.");
+
+    // get the first line (the window)
+    const char *lineEnd = findLineEnd(begin, end);
+    THROW_IF(lineEnd == begin, "No lines in scene file to read, must have at least one line with window.");
+    const char *p = begin;
     for (int i = 0; i < window.size(); i++)
     {
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), "First line must have at four numbers denoting window");
-        window[i] = stof(cell);
+        THROW_IF(parseCell(p, lineEnd, window[i]) != CellStatus::OK, "First line must have at four numbers denoting window");
+    }
+
+    // the circles (i.e. all of the remaining lines) are split into chunks of whole lines that are parsed in parallel
+    const char *body = lineEnd < end ? lineEnd + 1 : end;
+    long bodySize = end - body;
+    int nChunks = std::clamp(bodySize / MIN_CSV_CHUNK_SIZE, 1L, 4L * omp_get_max_threads());
+    vector<const char*> chunkStart(nChunks + 1);
+    chunkStart[0] = body;
+    chunkStart[nChunks] = end;
+    for (int k = 1; k < nChunks; k++)
+    {
+        const char *q = findLineEnd(body + bodySize * k / nChunks, end);
+        chunkStart[k] = q < end ? q + 1 : end;
+    }
+
+    // count the circles of each chunk first, so that every circle knows its index (and place in the arrays)
+    vector<long> firstCircle(nChunks + 1, 0);
+    #pragma omp parallel for schedule(dynamic) if (nChunks > 1)
+    for (int k = 0; k < nChunks; k++)
+    {
+        const char *start = chunkStart[k];
+        const char *stop = chunkStart[k + 1];
+        long n = std::count(start, stop, '\n');
+        if (stop > start && stop[-1] != '\n') n++;
+        firstCircle[k + 1] = n;
     }
+    std::partial_sum(firstCircle.begin(), firstCircle.end(), firstCircle.begin());
 
-    // get circles (i.e. all of the remaining lines)
-    while (getline(in, line))
+    long n = firstCircle[nChunks];
+    vector<float> xs(n), ys(n), rs(n);
+    vector<Vec3f> bs(n);
+
+    // exceptions can't leave the parallel loop, each chunk keeps the error of its first bad circle
+    vector<string> errors(nChunks);
+    #pragma omp parallel for schedule(dynamic) if (nChunks > 1)
+    for (int k = 0; k < nChunks; k++)
+    {
+        const char *stop = chunkStart[k + 1];
+        const char *line = chunkStart[k];
+        for (long i = firstCircle[k]; i < firstCircle[k + 1]; i++)
+        {
+            const char *lineEnd = findLineEnd(line, stop);
+            const char *p = line;
+            line = lineEnd + 1;
+            float *values[6] = { &xs[i], &ys[i], &rs[i], &bs[i].x(), &bs[i].y(), &bs[i].z() };
+            for (int j = 0; j < 6; j++)
+            {
+                CellStatus status = parseCell(p, lineEnd, *values[j]);
+                if (status == CellStatus::OK) continue;
+                errors[k] = "Circle #" + to_string(i) + (status == CellStatus::EMPTY ? " is missing " : " has an invalid ") + CIRCLE_FIELDS[j];
+                break;
+            }
+            if (!errors[k].empty()) break;
+        }
+    }
+
+    // report the first bad circle of the file, like a sequential parse would
+    for (string &error : errors)
     {
-        string circle_idx = "Circle #" + to_string(circles.size());
-        ss.clear();
-        ss.str(line);
-
-        // circle data
-        Vec2f c;
-        float r;
-        Vec3f b;
-
-        // get x, y coordinates
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing x coordinate");
-        c.x() = stof(cell);
-
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing y coordinate");
-        c.y() = stof(cell);
-
-        // get radius
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing radius");
-        r = stof(cell);
-
-        // get rgb boundary value
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing boundary red value");
-        b.x() = stof(cell);
-        
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing boundary green value");
-        b.y() = stof(cell);
-    
-        getline(ss, cell, ',');
-        THROW_IF(cell.empty(), circle_idx + " is missing boundary blue value");
-        b.z() = stof(cell);
-
-        // construct circle
-        circles.push_back(make_shared<Circle>(c, r, b));
+        THROW_IF(!error.empty(), error);
     }
 
-    std::cout << "Scene loading finished. Loaded " << circles.size() << " circles." << std::endl;
+    shared_ptr<vector<char>> sceneFile = buildSceneFile(window, xs, ys, rs, bs);
+    setArrays(sceneFile->data(), sceneFile->size(), filename);
+    storage = sceneFile;
+}
+
+void Scene::setArrays(const char *data, size_t size, string filename)
+{
+    SceneFileHeader header;
+    THROW_IF(size < sizeof(header), filename + " is too small to be a binary scene file");
+    std::memcpy(&header, data, sizeof(header));
+    THROW_IF(std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0, filename + " is not a binary scene file");
+    THROW_IF(header.version != SCENE_FILE_VERSION, "Unsupported version " + to_string(header.version) + " of binary scene file " + filename);
+    THROW_IF(header.fileSize != size, "Binary scene file " + filename + " should be " + to_string(header.fileSize) + " bytes, but is " + to_string(size));
+    THROW_IF(header.numCircles > INT_MAX, "Too many circles in " + filename);
+
+    // every array must be aligned and lie within the file
+    auto inFile = [size](uint64_t offset, uint64_t count, uint64_t elementSize) -> bool
+    {
+        return offset % elementSize == 0 && offset <= size && count <= (size - offset) / elementSize;
+    };
+    THROW_IF(!inFile(header.xOffset, header.numCircles, sizeof(float))
+        || !inFile(header.yOffset, header.numCircles, sizeof(float))
+        || !inFile(header.radiusOffset, header.numCircles, sizeof(float))
+        || !inFile(header.boundaryOffset, header.numCircles, sizeof(uint32_t))
+        || !inFile(header.paletteOffset, 3 * uint64_t(header.numColors), sizeof(float)),
+        "Arrays of binary scene file " + filename + " are out of bounds");
+
+    window = Vec4f(header.window[0], header.window[1], header.window[2], header.window[3]);
+    numCircles = header.numCircles;
+    centerX = reinterpret_cast<const float*>(data + header.xOffset);
+    centerY = reinterpret_cast<const float*>(data + header.yOffset);
+    radius = reinterpret_cast<const float*>(data + header.radiusOffset);
+    boundaryIndex = reinterpret_cast<const uint32_t*>(data + header.boundaryOffset);
+    palette = reinterpret_cast<const float*>(data + header.paletteOffset);
+    bytes = data;
+    numBytes = size;
+
+    for (int i = 0; i < numCircles; i++)
+    {
+        THROW_IF(boundaryIndex[i] >= header.numColors, "Circle #" + to_string(i) + " of " + filename + " has an invalid boundary value index");
+    }
 }
 
-Vec2f Scene::getClosestPoint(Vec2f o, Vec3f &b, bool isSetup)
+Vec2f Scene::getClosestPoint(Vec2f o, Vec3f &b, bool isSetup) const
 {
     Vec2f closestPoint;
     StatType statCounterType = isSetup
@@ -93,29 +281,55 @@ Stats::TIME_THREAD(statTimerType, [this, o, &closestPoint, &b]() -> void {
 
     // TODO: use KD tree to speed this up.
     float dist = std::numeric_limits<float>::max();
-    for (shared_ptr<Circle> c : circles)
+    int closest = -1;
+    for (int i = 0; i < numCircles; i++)
     {
-        Vec2f tempClosestPoint = c->getClosestPoint(o);
+        // closest point on the circle (same as Circle::getClosestPoint)
+        Vec2f c(centerX[i], centerY[i]);
+        Vec2f v = o - c;
+        float vnorm = v.norm();
+        Vec2f tempClosestPoint = vnorm < EPSILON
+            ? Vec2f(c + Vec2f(0, radius[i]))
+            : Vec2f(c + (v * radius[i] / vnorm));
+
         float tempDist = (tempClosestPoint - o).norm();
         if (tempDist < dist)
         {
             dist = tempDist;
             closestPoint = tempClosestPoint;
-            b = c->getBoundaryCondition();
+            closest = i;
         }
     }
+    if (closest >= 0)
+    {
+        const float *color = palette + 3 * boundaryIndex[closest];
+        b = Vec3f(color[0], color[1], color[2]);
+    }
 });
     return closestPoint;
 }
 
-Vec4f Scene::getWindow()
+Vec4f Scene::getWindow() const
 {
     return window;
 }
 
-string Scene::getName()
+string Scene::getName() const
 {
     return name;
 }
 
 
+
+int Scene::getNumCircles() const
+{
+    return numCircles;
+}
+
+void Scene::saveBinary(string filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    THROW_IF(!out.is_open(), "Unable to open scene file " + filename);
+    out.write(bytes, numBytes);
+    THROW_IF(!out, "Unable to write scene file " + filename);
+}
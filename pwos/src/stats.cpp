@@ -1,67 +1,94 @@
 #include <pwos/common.h>
 #include <pwos/stats.h>
 
-void Stats::init(int nthreads)
+// git hash of the build, set by CMake
+#ifndef PWOS_GIT_HASH
+#define PWOS_GIT_HASH "unknown"
+#endif
+
+void Stats::init(int nthreads, int timerSampleRate)
 {
-    threadTime = vector<fsec>(nthreads);
-    threadSendWalksTime = vector<fsec>(nthreads);
-    threadRecvWalksTime = vector<fsec>(nthreads);
-    threadCPGTime = vector<fsec>(nthreads);
-    threadCPQTime = vector<fsec>(nthreads);
-    threadCPQSetupTime = vector<fsec>(nthreads);
-    numClosestPointQueries = vector<int>(nthreads);
-    numGridQueries = vector<int>(nthreads);
-    numClosestPointQueriesSetup = vector<int>(nthreads);
+    THROW_IF(timerSampleRate < 1, "Timer sample rate must be at least 1.");
+    Stats::timerSampleRate = timerSampleRate;
+    gridCreationTime = totalTime = setupTime = renderTime = fsec(0);
+    numGridPoints = 0;
+    numWalks = 0;
+    threadStats = vector<ThreadStats>(nthreads);
+    for (ThreadStats &s : threadStats)
+    {
+        s.activeWalksSentTo = vector<long>(nthreads);
+        s.terminatedWalksSentTo = vector<long>(nthreads);
+    }
+    calibrate();
+    initCycles = readCycleCounter();
+    initTime = Time::now();
 }
 
-void Stats::TIME(StatTimerType type, FunctionBlock f)
+void Stats::calibrate()
 {
-    auto start = Time::now();
-    f();
-    switch (type)
+    // run the timers and counters on thread 0's block, then restore it
+    ThreadStats saved = threadStats[0];
+    const int n = 1 << 16;
+    uint64_t start = readCycleCounter();
+    for (int i = 0; i < n; i++)
     {
-        case StatTimerType::TOTAL:
-            totalTime += Time::now() - start;
-            break;
-        case StatTimerType::SETUP:
-            setupTime += Time::now() - start;
-            break;
-        case StatTimerType::GRID_CREATION:
-            gridCreationTime += Time::now() - start;
-            break;
+        ScopedTimer timer(StatTimerType::CLOSEST_POINT_QUERY);
     }
+    uint64_t mid = readCycleCounter();
+    for (int i = 0; i < n; i++)
+    {
+        INCREMENT_COUNT(StatType::WALK_STEPS);
+    }
+    uint64_t end = readCycleCounter();
+    threadStats[0] = saved;
+
+    timerCallCycles = double(mid - start) / n;
+    counterCallCycles = double(end - mid) / n;
+}
+
+double Stats::getCyclesPerSecond()
+{
+    fsec elapsed = Time::now() - initTime;
+    return double(readCycleCounter() - initCycles) / elapsed.count();
 }
 
-void Stats::TIME_THREAD(StatTimerType type, FunctionBlock f)
+long Stats::getNumWalkSteps()
+{
+    long numWalkSteps = 0;
+    for (ThreadStats &s : threadStats)
+    {
+        numWalkSteps += std::atomic_ref<long>(s.numWalkSteps).load(std::memory_order_relaxed);
+    }
+    return numWalkSteps;
+}
+
+float Stats::getThreadTime(int tid, StatTimerType type)
+{
+    return threadStats[tid].cycles[int(type)] / getCyclesPerSecond();
+}
+
+void Stats::addTime(StatTimerType type, fsec duration)
 {
-    size_t tid = omp_get_thread_num();
-    THROW_IF(threadTime.size() <= tid, "Must initialize thread timers. Thread " + to_string(tid) + " out of range.");
-    auto start = Time::now();
-    f();
     switch (type)
     {
         case StatTimerType::TOTAL:
-            threadTime[tid] += Time::now() - start;
-            break;
-        case StatTimerType::SEND_WALKS:
-            threadSendWalksTime[tid] += Time::now() - start;
+            totalTime += duration;
             break;
-     case StatTimerType::RECV_WALKS:
-            threadRecvWalksTime[tid] += Time::now() - start;
+        case StatTimerType::SETUP:
+            setupTime += duration;
             break;
-        case StatTimerType::CLOSEST_POINT_GRID:
-            threadCPGTime[tid] += Time::now() - start;
+        case StatTimerType::GRID_CREATION:
+            gridCreationTime += duration;
             break;
-        case StatTimerType::CLOSEST_POINT_QUERY:
-            threadCPQTime[tid] += Time::now() - start;
+        case StatTimerType::RENDER:
+            renderTime += duration;
             break;
-        case StatTimerType::SETUP_CLOSEST_POINT_QUERY:
-            threadCPQSetupTime[tid] += Time::now() - start;
+        default:
             break;
     }
 }
 
-void Stats::SET_COUNT(StatType type, int val)
+void Stats::SET_COUNT(StatType type, long val)
 {
     switch(type)
     {
@@ -69,22 +96,9 @@ void Stats::SET_COUNT(StatType type, int val)
             #pragma omp critical
             numGridPoints = val;
             break;
-    }
-}
-
-void Stats::INCREMENT_COUNT(StatType type)
-{
-    size_t tid = omp_get_thread_num();
-    switch(type)
-    {
-        case StatType::CLOSEST_POINT_QUERY:
-            numClosestPointQueries[tid] += 1;
-            break;
-        case StatType::SETUP_CLOSEST_POINT_QUERY:
-            numClosestPointQueriesSetup[tid] += 1;
-            break;
-        case StatType::GRID_QUERY:
-            numGridQueries[tid] += 1;
+        case StatType::WALKS:
+            #pragma omp critical
+            numWalks = val;
             break;
         default:
             break;
@@ -96,52 +110,73 @@ void Stats::report()
     std::cout << "-----------------------------------------" << std::endl;
     std::cout << "|     Profiling Results                 |" << std::endl;
     std::cout << "-----------------------------------------" << std::endl;
-    int nthreads = threadTime.size();
+    int nthreads = threadStats.size();
 
-    int totalCPQ = 0;
-    int totalSetupCPQ = 0;
-    int totalGQ = 0;
+    long totalCPQ = 0;
+    long totalSetupCPQ = 0;
+    long totalGQ = 0;
+    long totalSteps = 0;
+    uint64_t totalTimerCalls = 0, totalCounterCalls = 0;
     for (int i = 0; i < nthreads; i++)
     {
-        totalCPQ += numClosestPointQueries[i];
-        totalSetupCPQ += numClosestPointQueriesSetup[i];
-        totalGQ += numGridQueries[i];
+        totalSteps += threadStats[i].numWalkSteps;
+        totalCPQ += threadStats[i].numClosestPointQueries;
+        totalSetupCPQ += threadStats[i].numClosestPointQueriesSetup;
+        totalGQ += threadStats[i].numGridQueries;
+        totalCounterCalls += threadStats[i].counterCalls;
+        for (int t = 0; t < NUM_STAT_TIMER_TYPES; t++) totalTimerCalls += threadStats[i].calls[t];
     }
 
     std::cout << "Number of Closest Point Queries: " << totalCPQ << std::endl;
     std::cout << "Number of Closest Point Queries during Setup: " << totalSetupCPQ << std::endl;
-    std::cout << "Number of Grid Queries:" << totalGQ << std::endl;
-    std::cout << "Number of Grid Points" << numGridPoints << std::endl;
-    std::cout << "Total time:" << totalTime.count() << std::endl;
-    std::cout << "Setup time:" << setupTime.count() << std::endl;
-    std::cout << "Grid Creation Time:" << gridCreationTime.count() << std::endl;
+    std::cout << "Number of Grid Queries: " << totalGQ << std::endl;
+    std::cout << "Number of Grid Points: " << numGridPoints << std::endl;
+    std::cout << "Total Time: " << totalTime.count() << " s" << std::endl;
+    std::cout << "Setup Time: " << setupTime.count() << " s" << std::endl;
+    std::cout << "Grid Creation Time: " << gridCreationTime.count() << " s" << std::endl;
+    std::cout << "Render Time: " << renderTime.count() << " s" << std::endl;
+    std::cout << "Walks/sec: " << numWalks / renderTime.count() << std::endl;
+    std::cout << "Number of Walk Steps: " << totalSteps << std::endl;
+
+    // walk histograms, empty bins are skipped
+    long totalFallbacks = 0;
+    for (ThreadStats &s : threadStats) totalFallbacks += s.numGridFallbacks;
+    std::cout << "Number of Grid Fallbacks (grid bound below min radius): " << totalFallbacks << std::endl;
+    if (hasWalkHistograms())
+    {
+        std::cout << "Walk Histograms:" << std::endl;
+        for (auto &[metric, value] : getHistograms())
+        {
+            if (value > 0) std::cout << "\t " << metric << ": " << long(value) << std::endl;
+        }
+    }
 
     // average of thread times
     std::vector<float> threadTimeF, threadSendWalksTimeF, threadRecvWalksTimeF, threadCPGTimeF, threadCPQTimeF, threadCPQSetupTimeF;
     float totalSendTime = 0, totalRecvTime = 0, totalCPGTime = 0, totalCPQTime = 0, totalCPQSetupTime = 0;
     for (int i = 0; i < nthreads; i++)
     {
-        threadTimeF.push_back(threadTime[i].count());
-        threadSendWalksTimeF.push_back(threadSendWalksTime[i].count());
-        threadRecvWalksTimeF.push_back(threadRecvWalksTime[i].count());
-        threadCPGTimeF.push_back(threadCPGTime[i].count());
-        threadCPQTimeF.push_back(threadCPQTime[i].count());
-        threadCPQSetupTimeF.push_back(threadCPQSetupTime[i].count());
+        threadTimeF.push_back(getThreadTime(i, StatTimerType::TOTAL));
+        threadSendWalksTimeF.push_back(getThreadTime(i, StatTimerType::SEND_WALKS));
+        threadRecvWalksTimeF.push_back(getThreadTime(i, StatTimerType::RECV_WALKS));
+        threadCPGTimeF.push_back(getThreadTime(i, StatTimerType::CLOSEST_POINT_GRID));
+        threadCPQTimeF.push_back(getThreadTime(i, StatTimerType::CLOSEST_POINT_QUERY));
+        threadCPQSetupTimeF.push_back(getThreadTime(i, StatTimerType::SETUP_CLOSEST_POINT_QUERY));
 
-        totalSendTime += threadSendWalksTime[i].count();
-        totalRecvTime += threadRecvWalksTime[i].count();
-        totalCPGTime += threadCPGTime[i].count();
-        totalCPQTime += threadCPQTime[i].count();
-        totalCPQSetupTime += threadCPQSetupTime[i].count();
+        totalSendTime += threadSendWalksTimeF[i];
+        totalRecvTime += threadRecvWalksTimeF[i];
+        totalCPGTime += threadCPGTimeF[i];
+        totalCPQTime += threadCPQTimeF[i];
+        totalCPQSetupTime += threadCPQSetupTimeF[i];
     }
-    std::cout << "Total Send Time:" << totalSendTime << " s" << std::endl;
-    std::cout << "Total Recv Time:" << totalRecvTime << " s" << std::endl;
-    std::cout << "Total CPG Time:" << totalCPGTime << " s" << std::endl;
-    std::cout << "Total CPQ Time:" << totalCPQTime << " s" << std::endl;
-    std::cout << "Total CPQ During Setup Time:" << totalCPQSetupTime << " s" << std::endl;
+    std::cout << "Total Send Time: " << totalSendTime << " s" << std::endl;
+    std::cout << "Total Recv Time: " << totalRecvTime << " s" << std::endl;
+    std::cout << "Total CPG Time: " << totalCPGTime << " s" << std::endl;
+    std::cout << "Total CPQ Time: " << totalCPQTime << " s" << std::endl;
+    std::cout << "Total CPQ During Setup Time: " << totalCPQSetupTime << " s" << std::endl;
 
-    std::cout << "Avg CPQ Time" << (totalCPQSetupTime + totalCPQTime) / float(totalCPQ + totalSetupCPQ) << " s" << std::endl;
-    std::cout << "Avg GQ Time" << (totalCPGTime) / float(totalGQ) << " s" << std::endl;
+    std::cout << "Avg CPQ Time: " << (totalCPQSetupTime + totalCPQTime) / float(totalCPQ + totalSetupCPQ) << " s" << std::endl;
+    std::cout << "Avg GQ Time: " << (totalCPGTime) / float(totalGQ) << " s" << std::endl;
 
     auto [minThreadTime, maxThreadTime] = std::minmax_element(threadTimeF.begin(), threadTimeF.end());
     auto [minSendWalksTime, maxSendWalksTime] = std::minmax_element(threadSendWalksTimeF.begin(), threadSendWalksTimeF.end());
@@ -157,29 +192,377 @@ void Stats::report()
     float avgCPQTime = std::accumulate(threadCPQTimeF.begin(), threadCPQTimeF.end(), 0.0f) / float(nthreads);
     float avgCPQSetupTime = std::accumulate(threadCPQSetupTimeF.begin(), threadCPQSetupTimeF.end(), 0.0f) / float(nthreads);
 
-    std::cout << "Time per thread: ( avg=" << avgThreadTime << ", min=" << *minThreadTime << ", max="<< *maxThreadTime << ")" << std::endl;
-    std::cout << "Send Walks time: ( avg=" << avgSendWalksTime << ", min=" << *minSendWalksTime << ", max="<< *maxSendWalksTime << ")" << std::endl;
-    std::cout << "Recv Walks time: ( avg=" << avgRecvWalksTime << ", min=" << *minRecvWalksTime << ", max="<< *maxRecvWalksTime << ")" << std::endl;
-    std::cout << "CP Grid time: ( avg=" << avgCPGTime << ", min=" << *minCPGTime << ", max="<< *maxCPGTime << ")" << std::endl;
-    std::cout << "CP Query time: ( avg=" << avgCPQTime << ", min=" << *minCPQTime << ", max="<< *maxCPQTime << ")" << std::endl;
-    std::cout << "CP Query time during Setup: ( avg=" << avgCPQSetupTime << ", min=" << *minCPQSetupTime << ", max="<< *maxCPQSetupTime << ")" << std::endl;
+    std::cout << "Time per thread: (avg=" << avgThreadTime << ", min=" << *minThreadTime << ", max=" << *maxThreadTime << ")" << std::endl;
+    std::cout << "Send Walks time: (avg=" << avgSendWalksTime << ", min=" << *minSendWalksTime << ", max=" << *maxSendWalksTime << ")" << std::endl;
+    std::cout << "Recv Walks time: (avg=" << avgRecvWalksTime << ", min=" << *minRecvWalksTime << ", max=" << *maxRecvWalksTime << ")" << std::endl;
+    std::cout << "CP Grid time: (avg=" << avgCPGTime << ", min=" << *minCPGTime << ", max=" << *maxCPGTime << ")" << std::endl;
+    std::cout << "CP Query time: (avg=" << avgCPQTime << ", min=" << *minCPQTime << ", max=" << *maxCPQTime << ")" << std::endl;
+    std::cout << "CP Query time during Setup: (avg=" << avgCPQSetupTime << ", min=" << *minCPQSetupTime << ", max=" << *maxCPQSetupTime << ")" << std::endl;
+
+#if PWOS_STATS
+    // estimated cost of the timers and counters themselves, relative to the time of all threads
+    float overheadTime = (totalTimerCalls * timerCallCycles + totalCounterCalls * counterCallCycles) / getCyclesPerSecond();
+    float totalThreadTime = std::accumulate(threadTimeF.begin(), threadTimeF.end(), 0.0f);
+    std::cout << "Instrumentation overhead: " << overheadTime << " s (" << 100.0f * overheadTime / totalThreadTime << "% of thread time, "
+              << timerCallCycles << " cycles/timer call, " << counterCallCycles << " cycles/counter call, timer sample rate 1/" << timerSampleRate << ")" << std::endl;
+#else
+    std::cout << "Instrumentation disabled (PWOS_STATS=0)" << std::endl;
+#endif
+
+    // hardware counters of each phase, summed over the threads
+    if (PerfCounters::enabled)
+    {
+        std::cout << "Hardware counters:" << std::endl;
+        for (int t = 0; t < NUM_STAT_TIMER_TYPES; t++)
+        {
+            uint64_t counts[NUM_PERF_EVENTS] = {};
+            for (ThreadStats &s : threadStats)
+            {
+                for (int i = 0; i < NUM_PERF_EVENTS; i++) counts[i] += s.perf[t][i];
+            }
+            if (std::all_of(counts, counts + NUM_PERF_EVENTS, [](uint64_t c) { return c == 0; })) continue;
+
+            std::cout << "\t " << getStatTimerName(StatTimerType(t)) << ":";
+            for (int i = 0; i < NUM_PERF_EVENTS; i++)
+            {
+                if (PerfCounters::available[i]) std::cout << " " << getPerfEventName(PerfEvent(i)) << "=" << counts[i];
+            }
+            uint64_t cycles = counts[int(PerfEvent::CYCLES)];
+            if (cycles > 0) std::cout << " IPC=" << double(counts[int(PerfEvent::INSTRUCTIONS)]) / cycles;
+            std::cout << std::endl;
+        }
+    }
+
+    // MCWoG traffic between threads and queue depths
+    if (hasRounds())
+    {
+        std::cout << "MCWoG walk traffic (active walks sent, row = sender, column = receiver):" << std::endl;
+        for (int i = 0; i < nthreads; i++)
+        {
+            std::cout << "\t";
+            for (int j = 0; j < nthreads; j++) std::cout << " " << threadStats[i].activeWalksSentTo[j];
+            std::cout << std::endl;
+        }
+        std::cout << "MCWoG queue depth (active walks received per round):" << std::endl;
+        for (int i = 0; i < nthreads; i++)
+        {
+            ThreadStats &s = threadStats[i];
+            std::cout << "\t Thread #" << i << ": rounds=" << s.numRounds << ", mean=" << s.queueDepthSum / std::max(1.0, double(s.numRounds)) << ", max=" << s.maxQueueDepth << std::endl;
+        }
+    }
 
     // Distribution of thread times
-    if (nthreads > 1) 
+    if (nthreads > 1)
     {
         std::cout << "Distribution of Thread Time, CPQs, and GQs:" << std::endl;
-        for (int i = 0; i < threadTime.size(); i++)
+        for (int i = 0; i < nthreads; i++)
+        {
+            std::cout << "\t Thread #" << i << std::endl;
+            std::cout << "\t\t\t\t Total Time=" << threadTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t Send Time=" << threadSendWalksTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t Recv Time=" << threadRecvWalksTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t CPQ Time=" << threadCPQTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t CPQ Setup Time=" << threadCPQSetupTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t GQ Time=" << threadCPGTimeF[i] << " s" << std::endl;
+            std::cout << "\t\t\t\t CPQs=" << threadStats[i].numClosestPointQueries << std::endl;
+            std::cout << "\t\t\t\t CPQs Setup=" << threadStats[i].numClosestPointQueriesSetup << std::endl;
+            std::cout << "\t\t\t\t GQs=" << threadStats[i].numGridQueries << std::endl;
+        }
+    }
+}
+
+bool Stats::hasRounds()
+{
+    return std::any_of(threadStats.begin(), threadStats.end(), [](const ThreadStats &s) { return s.numRounds > 0; });
+}
+
+bool Stats::hasWalkHistograms()
+{
+    return std::any_of(threadStats.begin(), threadStats.end(), [](const ThreadStats &s)
+    {
+        return std::any_of(std::begin(s.terminations), std::end(s.terminations), [](long n) { return n > 0; });
+    });
+}
+
+void Stats::SET_CONFIG(string key, string value)
+{
+    for (auto &[k, v] : config)
+    {
+        if (k != key) continue;
+        v = value;
+        return;
+    }
+    config.emplace_back(key, value);
+}
+
+/**
+ * Metric name of a timer, e.g. "send_walks_time".
+ */
+static string getTimerMetricName(StatTimerType type)
+{
+    string name = getStatTimerName(type);
+    std::replace(name.begin(), name.end(), ' ', '_');
+    return name + "_time";
+}
+
+Stats::Metrics Stats::getTotals()
+{
+    long totalCPQ = 0, totalSetupCPQ = 0, totalGQ = 0, totalSteps = 0, totalFallbacks = 0;
+    for (ThreadStats &s : threadStats)
+    {
+        totalCPQ += s.numClosestPointQueries;
+        totalSetupCPQ += s.numClosestPointQueriesSetup;
+        totalGQ += s.numGridQueries;
+        totalSteps += s.numWalkSteps;
+        totalFallbacks += s.numGridFallbacks;
+    }
+    float render = renderTime.count();
+
+    return Metrics({
+        { "total_time", totalTime.count() },
+        { "setup_time", setupTime.count() },
+        { "grid_creation_time", gridCreationTime.count() },
+        { "render_time", render },
+        { "walks", numWalks },
+        { "walk_steps", totalSteps },
+        { "closest_point_queries", totalCPQ },
+        { "setup_closest_point_queries", totalSetupCPQ },
+        { "grid_queries", totalGQ },
+        { "grid_fallbacks", totalFallbacks },
+        { "grid_points", numGridPoints },
+        { "walks_per_sec", numWalks / render },
+        { "steps_per_sec", totalSteps / render },
+        { "queries_per_sec", (totalCPQ + totalGQ) / render }
+    });
+}
+
+Stats::Metrics Stats::getThreadMetrics(int tid)
+{
+    Metrics metrics;
+    for (int t = 0; t < NUM_STAT_TIMER_TYPES; t++)
+    {
+        StatTimerType type = StatTimerType(t);
+        metrics.emplace_back(getTimerMetricName(type), getThreadTime(tid, type));
+        for (int i = 0; PerfCounters::enabled && i < NUM_PERF_EVENTS; i++)
+        {
+            if (!PerfCounters::available[i]) continue;
+            string name = string(getStatTimerName(type)) + "_" + getPerfEventName(PerfEvent(i));
+            std::replace(name.begin(), name.end(), ' ', '_');
+            metrics.emplace_back(name, threadStats[tid].perf[t][i]);
+        }
+    }
+    metrics.emplace_back("closest_point_queries", threadStats[tid].numClosestPointQueries);
+    metrics.emplace_back("setup_closest_point_queries", threadStats[tid].numClosestPointQueriesSetup);
+    metrics.emplace_back("grid_queries", threadStats[tid].numGridQueries);
+    metrics.emplace_back("walk_steps", threadStats[tid].numWalkSteps);
+    metrics.emplace_back("grid_fallbacks", threadStats[tid].numGridFallbacks);
+    return metrics;
+}
+
+Stats::Metrics Stats::getHistograms()
+{
+    long stepsPerWalk[NUM_STEP_BINS] = {};
+    long stepRadius[NUM_RADIUS_BINS] = {};
+    long terminations[NUM_WALK_TERMINATIONS] = {};
+    long numEndedOutsideWindow = 0;
+    for (ThreadStats &s : threadStats)
+    {
+        for (int i = 0; i < NUM_STEP_BINS; i++) stepsPerWalk[i] += s.stepsPerWalk[i];
+        for (int i = 0; i < NUM_RADIUS_BINS; i++) stepRadius[i] += s.stepRadius[i];
+        for (int i = 0; i < NUM_WALK_TERMINATIONS; i++) terminations[i] += s.terminations[i];
+        numEndedOutsideWindow += s.numEndedOutsideWindow;
+    }
+
+    Metrics metrics;
+    for (int i = 0; i < NUM_STEP_BINS; i++)
+    {
+        string range = i + 1 < NUM_STEP_BINS ? to_string(1l << i) + "," + to_string(1l << (i + 1)) + ")" : to_string(1l << i) + ",inf)";
+        metrics.emplace_back("steps_per_walk[" + range, stepsPerWalk[i]);
+    }
+    for (int i = 0; i < NUM_RADIUS_BINS; i++)
+    {
+        std::stringstream range;
+        range << "[" << (i == 0 ? 0.0f : std::ldexp(1.0f, i + MIN_RADIUS_EXP)) << ",";
+        if (i + 1 < NUM_RADIUS_BINS) range << std::ldexp(1.0f, i + 1 + MIN_RADIUS_EXP) << ")";
+        else range << "inf)";
+        metrics.emplace_back("step_radius" + range.str(), stepRadius[i]);
+    }
+    for (int i = 0; i < NUM_WALK_TERMINATIONS; i++)
+    {
+        string name = string("termination_") + getWalkTerminationName(WalkTermination(i));
+        std::replace(name.begin(), name.end(), ' ', '_');
+        metrics.emplace_back(name, terminations[i]);
+    }
+    metrics.emplace_back("ended_outside_window", numEndedOutsideWindow);
+    return metrics;
+}
+
+/**
+ * Quote and escape a string for JSON.
+ */
+static string quote(string s)
+{
+    string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/**
+ * Quote and escape a string for CSV.
+ */
+static string csvQuote(string s)
+{
+    string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void Stats::writeJSON(string filename)
+{
+    std::ofstream out(filename);
+    THROW_IF(!out.is_open(), "Unable to open stats file " + filename);
+    out.precision(15);
+
+    auto writeMetrics = [&out](const Metrics &metrics, string indent) -> void
+    {
+        for (size_t i = 0; i < metrics.size(); i++)
+        {
+            out << indent << quote(metrics[i].first) << ": " << metrics[i].second << (i + 1 < metrics.size() ? "," : "") << std::endl;
+        }
+    };
+
+    out << "{" << std::endl;
+    out << "  \"config\": {" << std::endl;
+    for (auto &[key, value] : config)
+    {
+        out << "    " << quote(key) << ": " << quote(value) << "," << std::endl;
+    }
+    out << "    \"git_hash\": " << quote(PWOS_GIT_HASH) << std::endl;
+    out << "  }," << std::endl;
+
+    out << "  \"totals\": {" << std::endl;
+    writeMetrics(getTotals(), "    ");
+    out << "  }," << std::endl;
+
+    if (hasWalkHistograms())
+    {
+        out << "  \"histograms\": {" << std::endl;
+        writeMetrics(getHistograms(), "    ");
+        out << "  }," << std::endl;
+    }
+
+    if (hasRounds())
+    {
+        double cyclesPerSecond = getCyclesPerSecond();
+        out << "  \"mcwog\": {" << std::endl;
+        // row = sender, column = receiver
+        auto writeMatrix = [&out](string name, vector<long> ThreadStats::*sentTo) -> void
+        {
+            out << "    " << quote(name) << ": [" << std::endl;
+            for (size_t tid = 0; tid < threadStats.size(); tid++)
+            {
+                const vector<long> &row = threadStats[tid].*sentTo;
+                out << "      [";
+                for (size_t j = 0; j < row.size(); j++) out << (j > 0 ? ", " : "") << row[j];
+                out << "]" << (tid + 1 < threadStats.size() ? "," : "") << std::endl;
+            }
+            out << "    ]," << std::endl;
+        };
+        writeMatrix("active_walks_sent", &ThreadStats::activeWalksSentTo);
+        writeMatrix("terminated_walks_sent", &ThreadStats::terminatedWalksSentTo);
+
+        out << "    \"queue_depth\": [" << std::endl;
+        for (size_t tid = 0; tid < threadStats.size(); tid++)
+        {
+            ThreadStats &s = threadStats[tid];
+            out << "      {\"thread\": " << tid << ", \"rounds\": " << s.numRounds << ", \"mean\": " << s.queueDepthSum / std::max(1.0, double(s.numRounds))
+                << ", \"max\": " << s.maxQueueDepth << "}" << (tid + 1 < threadStats.size() ? "," : "") << std::endl;
+        }
+        out << "    ]," << std::endl;
+
+        out << "    \"region_timeline\": [" << std::endl;
+        bool first = true;
+        for (size_t tid = 0; tid < threadStats.size(); tid++)
+        {
+            for (RegionSample &sample : threadStats[tid].regionTimeline)
+            {
+                out << (first ? "" : ",\n") << "      {\"thread\": " << tid << ", \"time\": " << (double(sample.cycles) - double(initCycles)) / cyclesPerSecond
+                    << ", \"round\": " << sample.round << ", \"active_walks\": " << sample.activeWalks << "}";
+                first = false;
+            }
+        }
+        out << std::endl << "    ]" << std::endl;
+        out << "  }," << std::endl;
+    }
+
+    out << "  \"threads\": [" << std::endl;
+    for (size_t tid = 0; tid < threadStats.size(); tid++)
+    {
+        out << "    {" << std::endl;
+        out << "      \"thread\": " << tid << "," << std::endl;
+        writeMetrics(getThreadMetrics(tid), "      ");
+        out << "    }" << (tid + 1 < threadStats.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+void Stats::writeCSV(string filename)
+{
+    std::ofstream out(filename);
+    THROW_IF(!out.is_open(), "Unable to open stats file " + filename);
+    out.precision(15);
+
+    out << "section,thread,metric,value" << std::endl;
+    for (auto &[key, value] : config)
+    {
+        out << "config,," << key << "," << csvQuote(value) << std::endl;
+    }
+    out << "config,,git_hash," << csvQuote(PWOS_GIT_HASH) << std::endl;
+    for (auto &[metric, value] : getTotals())
+    {
+        out << "totals,," << metric << "," << value << std::endl;
+    }
+    if (hasWalkHistograms())
+    {
+        for (auto &[metric, value] : getHistograms())
+        {
+            out << "histograms,," << csvQuote(metric) << "," << value << std::endl;
+        }
+    }
+    for (size_t tid = 0; tid < threadStats.size(); tid++)
+    {
+        for (auto &[metric, value] : getThreadMetrics(tid))
+        {
+            out << "thread," << tid << "," << metric << "," << value << std::endl;
+        }
+    }
+    if (!hasRounds()) return;
+
+    // MCWoG traffic (thread = sender), queue depths and region load timeline (metric = time of the sample)
+    double cyclesPerSecond = getCyclesPerSecond();
+    for (size_t tid = 0; tid < threadStats.size(); tid++)
+    {
+        ThreadStats &s = threadStats[tid];
+        for (size_t receiver = 0; receiver < threadStats.size(); receiver++)
+        {
+            out << "active_walks_sent," << tid << ",to_" << receiver << "," << s.activeWalksSentTo[receiver] << std::endl;
+            out << "terminated_walks_sent," << tid << ",to_" << receiver << "," << s.terminatedWalksSentTo[receiver] << std::endl;
+        }
+        out << "queue_depth," << tid << ",rounds," << s.numRounds << std::endl;
+        out << "queue_depth," << tid << ",mean," << s.queueDepthSum / std::max(1.0, double(s.numRounds)) << std::endl;
+        out << "queue_depth," << tid << ",max," << s.maxQueueDepth << std::endl;
+        for (RegionSample &sample : s.regionTimeline)
         {
-            std::cout << "\t Thread #" << i << std::endl;;
-            std::cout << "\t\t\t\t Total Time=" << threadTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t Send Time=" << threadSendWalksTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t Recv Time=" << threadRecvWalksTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t CPQ Time=" << threadCPQTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t CPQ Setup Time=" << threadCPQSetupTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t GQ Time=" << threadCPGTime[i].count() << " s" << std::endl;;
-            std::cout << "\t\t\t\t CPQs=" << numClosestPointQueries[i] << " s" << std::endl;;
-            std::cout << "\t\t\t\t CPQs Setup=" << numClosestPointQueriesSetup[i] << " s" << std::endl;;
-            std::cout << "\t\t\t\t GQs=" << numGridQueries[i] << std::endl;
+            out << "region_timeline," << tid << ",t=" << (double(sample.cycles) - double(initCycles)) / cyclesPerSecond << "," << sample.activeWalks << std::endl;
         }
     }
 }
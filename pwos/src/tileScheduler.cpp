@@ -0,0 +1,86 @@
+#include <pwos/common.h>
+#include <pwos/tileScheduler.h>
+
+TileScheduler::TileScheduler(Vec2i res, int tileSize, int nthreads)
+{
+    THROW_IF(tileSize <= 0, "Tile size must be positive, got " + to_string(tileSize));
+    auto numTiles = [res](int size) -> long
+    {
+        return long((res.x() + size - 1) / size) * ((res.y() + size - 1) / size);
+    };
+    while (tileSize > 1 && numTiles(tileSize) < long(MIN_TILES_PER_THREAD) * nthreads)
+    {
+        tileSize /= 2;
+    }
+    int nTilesX = (res.x() + tileSize - 1) / tileSize;
+    int nTilesY = (res.y() + tileSize - 1) / tileSize;
+
+    // order tiles along a morton curve so that tiles close in the order are close in the image
+    vector<std::pair<uint32_t, Vec4i>> keyed;
+    for (int ty = 0; ty < nTilesY; ty++)
+    {
+        for (int tx = 0; tx < nTilesX; tx++)
+        {
+            Vec4i tile(
+                tx * tileSize,
+                ty * tileSize,
+                std::min((tx + 1) * tileSize, res.x()),
+                std::min((ty + 1) * tileSize, res.y())
+            );
+            keyed.emplace_back(mortonEncode(tx, ty), tile);
+        }
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (auto &[key, tile] : keyed)
+    {
+        tiles.push_back(tile);
+    }
+
+    // deal a contiguous range of tiles to each thread
+    queues = vector<deque<int>>(nthreads);
+    for (int i = 0; i < nthreads; i++)
+    {
+        locks.push_back(make_shared<mutex>());
+        int begin = (long(tiles.size()) * i) / nthreads;
+        int end = (long(tiles.size()) * (i + 1)) / nthreads;
+        for (int t = begin; t < end; t++)
+        {
+            queues[i].push_back(t);
+        }
+    }
+}
+
+bool TileScheduler::next(int tid, Vec4i &tile)
+{
+    int nthreads = queues.size();
+
+    // take work from the front of our own deque
+    {
+        std::lock_guard<mutex> guard(*locks[tid]);
+        if (!queues[tid].empty())
+        {
+            tile = tiles[queues[tid].front()];
+            queues[tid].pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other threads' deques
+    for (int i = 1; i < nthreads; i++)
+    {
+        int victim = (tid + i) % nthreads;
+        std::lock_guard<mutex> guard(*locks[victim]);
+        if (!queues[victim].empty())
+        {
+            tile = tiles[queues[victim].back()];
+            queues[victim].pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+int TileScheduler::getNumTiles()
+{
+    return tiles.size();
+}
@@ -0,0 +1,63 @@
+#include <pwos/common.h>
+#include <pwos/trace.h>
+
+void Trace::init(int nthreads, int capacity)
+{
+    THROW_IF(capacity <= 0, "Trace capacity must be positive, got " + to_string(capacity));
+    buffers = vector<TraceBuffer>(nthreads);
+    for (TraceBuffer &buffer : buffers)
+    {
+        buffer.events.resize(capacity);
+    }
+    initCycles = readCycleCounter();
+    initTime = Time::now();
+    enabled = true;
+}
+
+void Trace::write(string filename)
+{
+    std::ofstream out(filename);
+    THROW_IF(!out.is_open(), "Unable to open trace file " + filename);
+
+    // cycles to microseconds since init
+    fsec elapsed = Time::now() - initTime;
+    double cyclesPerMicrosecond = double(readCycleCounter() - initCycles) / (elapsed.count() * 1e6);
+    auto toMicroseconds = [cyclesPerMicrosecond](uint64_t cycles) -> double
+    {
+        return (double(cycles) - double(initCycles)) / cyclesPerMicrosecond;
+    };
+
+    out << std::fixed;
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    for (size_t tid = 0; tid < buffers.size(); tid++)
+    {
+        TraceBuffer &buffer = buffers[tid];
+        if (tid > 0) out << "," << std::endl;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"Thread " << tid << "\"}}";
+
+        auto writeEvent = [&out, tid, &toMicroseconds](const TraceEvent &e) -> void
+        {
+            out << "," << std::endl;
+            out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+                << ",\"ts\":" << toMicroseconds(e.start) << ",\"dur\":" << toMicroseconds(e.end) - toMicroseconds(e.start);
+            if (e.id >= 0) out << ",\"args\":{\"id\":" << e.id << "}";
+            out << "}";
+        };
+
+        for (const TraceEvent &e : buffer.phases)
+        {
+            writeEvent(e);
+        }
+
+        // oldest event first, the buffer wraps around once full
+        uint64_t capacity = buffer.events.size();
+        uint64_t first = buffer.numRecorded > capacity ? buffer.numRecorded - capacity : 0;
+        WARN_IF(first > 0, "Trace of thread " + to_string(tid) + " dropped its " + to_string(first) + " oldest events (see --tracesize).");
+        for (uint64_t i = first; i < buffer.numRecorded; i++)
+        {
+            writeEvent(buffer.events[i % capacity]);
+        }
+    }
+    out << std::endl << "]}" << std::endl;
+}